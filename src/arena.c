@@ -0,0 +1,107 @@
+/** @file
+ * Implementacja alokatora bloków o stałych rozmiarach
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include "arena.h"
+
+/**
+ * Rozmiar pamięci przeznaczonej na bloki w jednym slabie.
+ */
+#define SLAB_BYTES (64 * 1024)
+
+/** @brief Duży, jednorazowo alokowany fragment pamięci dzielony na bloki.
+ */
+struct Slab {
+    /**
+     * Wskaźnik na następny slab puli.
+     */
+    Slab *next;
+    /**
+     * Liczba bloków mieszczących się w slabie.
+     */
+    size_t capacity;
+    /**
+     * Pamięć na bloki.
+     */
+    max_align_t blocks[];
+};
+
+void arenaInit(Arena *arena, size_t base, size_t step, unsigned classes) {
+    assert(classes <= ARENA_MAX_CLASSES);
+    for (unsigned k = 0; k < classes; k++) {
+        size_t size = base + k * step;
+        size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+        arena->pools[k].blockSize = size;
+        arena->pools[k].freeList = NULL;
+        arena->pools[k].slabs = NULL;
+        arena->pools[k].used = 0;
+        arena->pools[k].live = 0;
+        arena->pools[k].bytes = 0;
+    }
+    arena->classes = classes;
+}
+
+void * arenaAlloc(Arena *arena, unsigned sizeClass) {
+    assert(sizeClass < arena->classes);
+    ArenaPool *pool = &arena->pools[sizeClass];
+    if (pool->freeList != NULL) {
+        void *block = pool->freeList;
+        pool->freeList = *(void **) block;
+        pool->live++;
+        return block;
+    }
+    if (pool->slabs == NULL || pool->used == pool->slabs->capacity) {
+        size_t capacity = SLAB_BYTES / pool->blockSize;
+        Slab *slab = malloc(sizeof(Slab) + capacity * pool->blockSize);
+        if (slab == NULL) {
+            return NULL;
+        }
+        slab->next = pool->slabs;
+        slab->capacity = capacity;
+        pool->slabs = slab;
+        pool->used = 0;
+        pool->bytes += sizeof(Slab) + capacity * pool->blockSize;
+    }
+    pool->live++;
+    char *blocks = (char *) pool->slabs->blocks;
+    return blocks + pool->blockSize * pool->used++;
+}
+
+void arenaFree(Arena *arena, unsigned sizeClass, void *block) {
+    assert(sizeClass < arena->classes);
+    if (block != NULL) {
+        ArenaPool *pool = &arena->pools[sizeClass];
+        *(void **) block = pool->freeList;
+        pool->freeList = block;
+        pool->live--;
+    }
+}
+
+size_t arenaBytes(Arena const *arena) {
+    size_t bytes = 0;
+    for (unsigned k = 0; k < arena->classes; k++) {
+        bytes += arena->pools[k].bytes;
+    }
+    return bytes;
+}
+
+void arenaRelease(Arena *arena) {
+    for (unsigned k = 0; k < arena->classes; k++) {
+        ArenaPool *pool = &arena->pools[k];
+        while (pool->slabs != NULL) {
+            Slab *next = pool->slabs->next;
+            free(pool->slabs);
+            pool->slabs = next;
+        }
+        pool->freeList = NULL;
+        pool->used = 0;
+        pool->live = 0;
+        pool->bytes = 0;
+    }
+}
@@ -0,0 +1,115 @@
+/** @file
+ * Interfejs alokatora bloków o stałych rozmiarach
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * Maksymalna liczba klas rozmiarów obsługiwanych przez jeden alokator.
+ */
+#define ARENA_MAX_CLASSES 16
+
+/**
+ * @typedef Slab
+ * @brief Duży, jednorazowo alokowany fragment pamięci dzielony na bloki.
+ */
+typedef struct Slab Slab;
+
+/** @brief Pula bloków jednego rozmiaru.
+ * Bloki wydzielane są kolejno z ostatniego slabu, a zwolnione bloki
+ * trafiają na listę wolnych bloków, której wskaźniki zapisane są
+ * w samych blokach.
+ */
+typedef struct ArenaPool {
+    /**
+     * Rozmiar pojedynczego bloku w bajtach.
+     */
+    size_t blockSize;
+    /**
+     * Lista zwolnionych bloków.
+     */
+    void *freeList;
+    /**
+     * Lista slabów puli; pierwszy z nich jest obecnie wypełniany.
+     */
+    Slab *slabs;
+    /**
+     * Liczba bloków wydzielonych z pierwszego slabu.
+     */
+    size_t used;
+    /**
+     * Liczba przydzielonych i jeszcze niezwolnionych bloków.
+     */
+    size_t live;
+    /**
+     * Łączny rozmiar slabów puli w bajtach.
+     */
+    size_t bytes;
+} ArenaPool;
+
+/** @brief Alokator bloków o kilku stałych rozmiarach.
+ * Klasa rozmiaru @p k ma bloki o rozmiarze @p base + @p k * @p step,
+ * zaokrąglonym w górę do wielokrotności rozmiaru wskaźnika.
+ * Cała pamięć zwalniana jest naraz, bez przechodzenia po blokach.
+ */
+typedef struct Arena {
+    /**
+     * Pule kolejnych klas rozmiarów.
+     */
+    ArenaPool pools[ARENA_MAX_CLASSES];
+    /**
+     * Liczba używanych klas rozmiarów.
+     */
+    unsigned classes;
+} Arena;
+
+/** @brief Inicjuje alokator.
+ * Inicjuje pusty alokator z @p classes klasami rozmiarów.
+ * Nie alokuje pamięci.
+ * @param[out] arena – wskaźnik na inicjowany alokator;
+ * @param[in] base   – rozmiar bloku klasy 0;
+ * @param[in] step   – przyrost rozmiaru bloku między kolejnymi klasami;
+ * @param[in] classes – liczba klas, co najwyżej @ref ARENA_MAX_CLASSES.
+ */
+void arenaInit(Arena *arena, size_t base, size_t step, unsigned classes);
+
+/** @brief Przydziela blok.
+ * Przydziela blok klasy rozmiaru @p sizeClass, w pierwszej kolejności
+ * z listy zwolnionych bloków.
+ * @param[in,out] arena – wskaźnik na alokator;
+ * @param[in] sizeClass – klasa rozmiaru bloku.
+ * @return Wskaźnik na przydzielony blok lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+void * arenaAlloc(Arena *arena, unsigned sizeClass);
+
+/** @brief Zwalnia blok.
+ * Dokłada blok do listy wolnych bloków jego klasy rozmiaru.
+ * Nic nie robi, jeśli wskaźnik @p block ma wartość NULL.
+ * @param[in,out] arena – wskaźnik na alokator;
+ * @param[in] sizeClass – klasa rozmiaru, z której przydzielono blok;
+ * @param[in] block     – wskaźnik na zwalniany blok.
+ */
+void arenaFree(Arena *arena, unsigned sizeClass, void *block);
+
+/** @brief Zwraca rozmiar pamięci alokatora.
+ * @param[in] arena – wskaźnik na alokator.
+ * @return Łączny rozmiar slabów wszystkich klas w bajtach.
+ */
+size_t arenaBytes(Arena const *arena);
+
+/** @brief Zwalnia całą pamięć alokatora.
+ * Zwalnia wszystkie slaby, unieważniając wszystkie przydzielone bloki.
+ * Alokator pozostaje pusty i można go dalej używać.
+ * @param[in,out] arena – wskaźnik na alokator.
+ */
+void arenaRelease(Arena *arena);
+
+#endif /* __ARENA_H__ */
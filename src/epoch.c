@@ -0,0 +1,78 @@
+/** @file
+ * Implementacja odroczonego zwalniania pamięci opartego na epokach
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <sched.h>
+#include <stdbool.h>
+#include "epoch.h"
+
+/**
+ * Numer licznika czytelników bieżącego wątku powiększony o 1 lub 0,
+ * jeśli wątek nie ma jeszcze przydzielonego licznika.
+ */
+static _Thread_local unsigned threadStripe;
+
+/**
+ * Liczba wątków, którym przydzielono licznik.
+ */
+static unsigned threadCount;
+
+/** @brief Zwraca numer licznika czytelników bieżącego wątku.
+ * Przydziela wątkom liczniki po kolei, więc kolejne wątki trafiają
+ * na różne linie pamięci podręcznej.
+ * @return Numer licznika mniejszy od @ref EPOCH_STRIPES.
+ */
+static unsigned stripeOfThread(void) {
+    if (threadStripe == 0) {
+        unsigned count = __atomic_fetch_add(&threadCount, 1, __ATOMIC_RELAXED);
+        threadStripe = count % EPOCH_STRIPES + 1;
+    }
+    return threadStripe - 1;
+}
+
+void epochInit(Epoch *epoch) {
+    epoch->current = 0;
+    for (unsigned parity = 0; parity < 2; parity++) {
+        for (unsigned s = 0; s < EPOCH_STRIPES; s++) {
+            epoch->stripes[parity][s].readers = 0;
+        }
+    }
+}
+
+unsigned epochEnter(Epoch *epoch) {
+    unsigned stripe = stripeOfThread();
+    while (true) {
+        uint64_t current = __atomic_load_n(&epoch->current, __ATOMIC_SEQ_CST);
+        unsigned parity = (unsigned) (current & 1);
+        size_t *readers = &epoch->stripes[parity][stripe].readers;
+        __atomic_add_fetch(readers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&epoch->current, __ATOMIC_SEQ_CST) == current) {
+            return parity * EPOCH_STRIPES + stripe;
+        }
+        __atomic_sub_fetch(readers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void epochExit(Epoch *epoch, unsigned token) {
+    EpochStripe *stripe =
+            &epoch->stripes[token / EPOCH_STRIPES][token % EPOCH_STRIPES];
+    __atomic_sub_fetch(&stripe->readers, 1, __ATOMIC_RELEASE);
+}
+
+void epochSynchronize(Epoch *epoch) {
+    uint64_t previous =
+            __atomic_fetch_add(&epoch->current, 1, __ATOMIC_SEQ_CST);
+    unsigned parity = (unsigned) (previous & 1);
+    for (unsigned s = 0; s < EPOCH_STRIPES; s++) {
+        size_t *readers = &epoch->stripes[parity][s].readers;
+        while (__atomic_load_n(readers, __ATOMIC_ACQUIRE) != 0) {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/** @file
+ * Interfejs odroczonego zwalniania pamięci oparty na epokach
+ *
+ * Czytelnicy oznaczają swoje sekcje krytyczne, nie blokując się nawzajem
+ * ani na piszącym. Piszący, zanim zwolni odłączoną pamięć, czeka, aż
+ * zakończą się wszystkie sekcje krytyczne rozpoczęte przed jej
+ * odłączeniem. Liczniki czytelników są rozłożone na kilka linii pamięci
+ * podręcznej, by wątki czytające nie rywalizowały o jedną.
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Liczba liczników czytelników dla jednej parzystości epoki.
+ */
+#define EPOCH_STRIPES 16
+
+/**
+ * Rozmiar linii pamięci podręcznej w bajtach.
+ */
+#define EPOCH_LINE 64
+
+/** @brief Licznik czytelników zajmujący własną linię pamięci podręcznej.
+ */
+typedef struct EpochStripe {
+    /**
+     * Liczba czytelników w sekcji krytycznej.
+     */
+    _Alignas(EPOCH_LINE) size_t readers;
+} EpochStripe;
+
+/** @brief Domena odroczonego zwalniania pamięci.
+ * Czytelnik zwiększa licznik parzystości bieżącej epoki. Piszący zmienia
+ * epokę i czeka, aż liczniki poprzedniej parzystości spadną do zera.
+ * Wymaga wyrównania do @ref EPOCH_LINE bajtów.
+ */
+typedef struct Epoch {
+    /**
+     * Numer bieżącej epoki.
+     */
+    _Alignas(EPOCH_LINE) uint64_t current;
+    /**
+     * Liczniki czytelników indeksowane parzystością epoki i numerem
+     * licznika wątku.
+     */
+    EpochStripe stripes[2][EPOCH_STRIPES];
+} Epoch;
+
+/** @brief Inicjuje domenę.
+ * @param[out] epoch – wskaźnik na inicjowaną domenę.
+ */
+void epochInit(Epoch *epoch);
+
+/** @brief Rozpoczyna sekcję krytyczną czytelnika.
+ * Nie blokuje się. Wskaźniki odczytane w sekcji krytycznej pozostają
+ * ważne do jej końca.
+ * @param[in,out] epoch – wskaźnik na domenę.
+ * @return Znacznik sekcji, który należy przekazać do @ref epochExit.
+ */
+unsigned epochEnter(Epoch *epoch);
+
+/** @brief Kończy sekcję krytyczną czytelnika.
+ * @param[in,out] epoch – wskaźnik na domenę;
+ * @param[in] token     – znacznik zwrócony przez @ref epochEnter.
+ */
+void epochExit(Epoch *epoch, unsigned token);
+
+/** @brief Czeka na zakończenie trwających sekcji krytycznych.
+ * Po powrocie żaden czytelnik nie trzyma wskaźnika na pamięć odłączoną
+ * przed wywołaniem, więc można ją zwolnić. Wywołania muszą być
+ * wzajemnie wykluczane przez piszących.
+ * @param[in,out] epoch – wskaźnik na domenę.
+ */
+void epochSynchronize(Epoch *epoch);
+
+#endif /* __EPOCH_H__ */
@@ -0,0 +1,210 @@
+/** @file
+ * Implementacja operacji na spakowanych numerach telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "number.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+int8_t const symbolValues[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, 11, -1, -1, -1, -1, -1, -1, 10, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+char const symbolChars[] = "0123456789*#";
+
+#if defined(__SSE2__)
+/** @brief Klasyfikuje znaki bloku 16 bajtów.
+ * @param[in] block – wczytany blok znaków.
+ * @param[out] end – maska bitowa znaków '\0' w bloku.
+ * @return Maska bitowa znaków bloku niebędących symbolami.
+ */
+static inline unsigned classify16(__m128i block, unsigned *end) {
+    __m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8('0'));
+    __m128i digit = _mm_cmpeq_epi8(
+            _mm_min_epu8(shifted, _mm_set1_epi8(9)), shifted);
+    __m128i symbol = _mm_or_si128(digit, _mm_or_si128(
+            _mm_cmpeq_epi8(block, _mm_set1_epi8('*')),
+            _mm_cmpeq_epi8(block, _mm_set1_epi8('#'))));
+    *end = (unsigned) _mm_movemask_epi8(
+            _mm_cmpeq_epi8(block, _mm_setzero_si128()));
+    return ~(unsigned) _mm_movemask_epi8(symbol) & 0xFFFFu;
+}
+
+/** @brief Wyznacza długość poprawnego numeru instrukcjami SSE2.
+ * Wczytuje bloki wyrównane do 16 bajtów, więc nigdy nie przekracza
+ * granicy strony pamięci, choć może czytać bajty spoza napisu.
+ * @param[in] num – wskaźnik na sprawdzany napis.
+ * @return Długość numeru albo 0, jeśli napis jest pusty lub zawiera znak
+ *         niebędący symbolem.
+ */
+__attribute__((no_sanitize_address))
+static size_t numberLengthSse2(char const *num) {
+    size_t skip = (uintptr_t) num % 16;
+    char const *block = num - skip;
+    unsigned end;
+    unsigned bad = classify16(_mm_load_si128((__m128i const *) block), &end);
+    end = end >> skip << skip;
+    bad = bad >> skip << skip;
+    while (end == 0) {
+        if (bad != 0) return 0;
+        block += 16;
+        bad = classify16(_mm_load_si128((__m128i const *) block), &end);
+    }
+    unsigned first = end & -end;
+    if ((bad & (first - 1)) != 0) return 0;
+    return (size_t) (block - num) + __builtin_ctz(end);
+}
+
+/** @brief Wyznacza długość poprawnego numeru instrukcjami AVX2.
+ * Najpierw sprawdza instrukcjami SSE2 znaki do granicy 32 bajtów,
+ * a potem wczytuje bloki wyrównane do 32 bajtów.
+ * @param[in] num – wskaźnik na sprawdzany napis.
+ * @return Długość numeru albo 0, jeśli napis jest pusty lub zawiera znak
+ *         niebędący symbolem.
+ */
+__attribute__((target("avx2"), no_sanitize_address))
+static size_t numberLengthAvx2(char const *num) {
+    size_t skip = (uintptr_t) num % 32;
+    char const *block = num - skip;
+    __m256i zero = _mm256_setzero_si256();
+    __m256i nine = _mm256_set1_epi8(9);
+    __m256i base = _mm256_set1_epi8('0');
+    __m256i star = _mm256_set1_epi8('*');
+    __m256i hash = _mm256_set1_epi8('#');
+    uint32_t mask = UINT32_MAX << skip;
+    while (true) {
+        __m256i chars = _mm256_load_si256((__m256i const *) block);
+        __m256i shifted = _mm256_sub_epi8(chars, base);
+        __m256i symbol = _mm256_or_si256(
+                _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, nine), shifted),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chars, star),
+                    _mm256_cmpeq_epi8(chars, hash)));
+        uint32_t end = (uint32_t) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(chars, zero)) & mask;
+        uint32_t bad = ~(uint32_t) _mm256_movemask_epi8(symbol) & mask;
+        if (end != 0) {
+            uint32_t first = end & -end;
+            if ((bad & (first - 1)) != 0) return 0;
+            return (size_t) (block - num) + __builtin_ctz(end);
+        }
+        if (bad != 0) return 0;
+        block += 32;
+        mask = UINT32_MAX;
+    }
+}
+#endif
+
+int numberCompare(char const *num1, char const *num2) {
+    size_t i = 0;
+    while (num1[i] != '\0' && num1[i] == num2[i]) {
+        i++;
+    }
+    if (num1[i] == num2[i]) return 0;
+    if (num1[i] == '\0')    return -1;
+    if (num2[i] == '\0')    return 1;
+    return charToInt(num1[i]) < charToInt(num2[i]) ? -1 : 1;
+}
+
+size_t numberLength(char const *num) {
+    if (num == NULL) {
+        return 0;
+    }
+#if defined(__SSE2__)
+    if (__builtin_cpu_supports("avx2")) {
+        return numberLengthAvx2(num);
+    }
+    return numberLengthSse2(num);
+#else
+    size_t i = 0;
+    while (isSymbol(num[i])) {
+        i++;
+    }
+    return num[i] == '\0' ? i : 0;
+#endif
+}
+
+void packedPack(PackedNumber *number, char const *num, size_t length) {
+    number->length = (uint32_t) length;
+    size_t i = 0;
+    for (; i + 1 < length; i += 2) {
+        number->digits[i / 2] =
+                (uint8_t) (charToInt(num[i]) << 4 | charToInt(num[i + 1]));
+    }
+    if (i < length) {
+        number->digits[i / 2] = (uint8_t) (charToInt(num[i]) << 4);
+    }
+}
+
+PackedNumber * packedFromString(char const *num) {
+    size_t length = strlen(num);
+    PackedNumber *number = malloc(packedSize(length));
+    if (number != NULL) {
+        packedPack(number, num, length);
+    }
+    return number;
+}
+
+char * packedUnpack(PackedNumber const *number, char *out) {
+    for (size_t i = 0; i < number->length; i++) {
+        out[i] = intToChar(packedDigit(number, i));
+    }
+    out[number->length] = '\0';
+    return out + number->length;
+}
+
+bool packedEqual(PackedNumber const *a, PackedNumber const *b) {
+    return a->length == b->length
+            && memcmp(a->digits, b->digits, (a->length + 1) / 2) == 0;
+}
+
+bool packedIsPrefix(PackedNumber const *prefix, PackedNumber const *number) {
+    if (prefix->length > number->length) {
+        return false;
+    }
+    size_t bytes = prefix->length / 2;
+    if (memcmp(prefix->digits, number->digits, bytes) != 0) {
+        return false;
+    }
+    return prefix->length % 2 == 0
+            || (prefix->digits[bytes] >> 4) == (number->digits[bytes] >> 4);
+}
+
+int packedCompare(PackedNumber const *a, PackedNumber const *b) {
+    size_t length = a->length < b->length ? a->length : b->length;
+    size_t bytes = length / 2;
+    int result = memcmp(a->digits, b->digits, bytes);
+    if (result != 0) {
+        return result;
+    }
+    if (length % 2 == 1) {
+        result = (a->digits[bytes] >> 4) - (b->digits[bytes] >> 4);
+        if (result != 0) {
+            return result;
+        }
+    }
+    if (a->length == b->length) return 0;
+    return a->length < b->length ? -1 : 1;
+}
@@ -0,0 +1,190 @@
+/** @file
+ * Interfejs operacji na symbolach i spakowanych numerach telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Tablica dekodująca symbole: dla cyfr od 0 do 9 ich wartość,
+ * dla znaków '*' i '#' wartości 10 i 11, a dla pozostałych znaków -1.
+ */
+extern int8_t const symbolValues[256];
+
+/**
+ * Tablica kodująca symbole, odwrotna do tablicy @ref symbolValues.
+ */
+extern char const symbolChars[];
+
+/** @brief Sprawdza popraność symbolu.
+ * Sprawdza, czy podany symbol należy do
+ * zadanego w zadaniu systemu liczbowego.
+ * Akceptuje więc cyfry od 0 do 9 oraz znaki * i #.
+ * @param[in] c – sprawdzany znak.
+ * @return Wartość @p true, gdy znak jest cyfrą podanego systemu liczbowego.
+ *         Wartość @p false, w przeciwnym przypadku.
+ */
+static inline bool isSymbol(char c) {
+    return symbolValues[(unsigned char) c] >= 0;
+}
+
+/** @brief Zmienia znak typu char na odpowiadającą mu liczbę typu short.
+ * Znaki reprezentujące cyfry zmienia na odpowiadającą cyfrę,
+ * znak '*' tratkuje jako 10 a znak '#' jako 11.
+ * @param[in] c – zmieniany znak, będący symbolem.
+ * @return Wartość typu short, odpowiednią dla podanego znaku.
+ */
+static inline short charToInt(char c) {
+    return symbolValues[(unsigned char) c];
+}
+
+/** @brief Zmienia podaną liczbę typu short na odpowiadający jej znak.
+ * Odwrotność funkcji @ref charToInt;
+ * @param[in] x – zmieniana liczba, od 0 do 11.
+ * @return Wartość typu char, odpowiednią dla podanej liczby.
+ */
+static inline char intToChar(short x) {
+    return symbolChars[x];
+}
+
+/** @brief Wyznacza długość poprawnego numeru.
+ * Sprawdza, czy napis @p num składa się wyłącznie z symboli, i wyznacza
+ * przy tym jego długość. Na procesorach x86 sprawdza 16 znaków naraz
+ * instrukcjami SSE2 albo 32 znaki naraz instrukcjami AVX2, jeśli
+ * procesor je obsługuje; w pozostałych przypadkach sprawdza kolejne
+ * znaki za pomocą tablicy @ref symbolValues.
+ * @param[in] num – wskaźnik na sprawdzany napis lub NULL.
+ * @return Długość numeru albo 0, jeśli @p num jest NULL-em, jest pusty
+ *         lub zawiera znak niebędący symbolem.
+ */
+size_t numberLength(char const *num);
+
+/** @brief Porównuje dwa numery w porządku leksykograficznym.
+ * Cyfry są porównywane według ich wartości, a prefiks numeru
+ * poprzedza ten numer.
+ * @param[in] num1 – wskaźnik na pierwszy numer;
+ * @param[in] num2 – wskaźnik na drugi numer.
+ * @return Liczba ujemna, jeśli @p num1 poprzedza @p num2,
+ *         zero, jeśli numery są równe,
+ *         liczba dodatnia, jeśli @p num2 poprzedza @p num1.
+ */
+int numberCompare(char const *num1, char const *num2);
+
+/** @brief Spakowany numer telefonu.
+ * Przechowuje cyfry numeru po cztery bity, w kolejności od starszej
+ * połówki bajtu, wraz z liczbą cyfr. Kody cyfr to wartości
+ * @ref charToInt, więc porównywanie bajtów zachowuje porządek numerów.
+ * Niewykorzystana połówka ostatniego bajtu jest zawsze zerem, dzięki czemu
+ * równe numery mają równe reprezentacje.
+ */
+typedef struct PackedNumber {
+    /**
+     * Liczba cyfr numeru.
+     */
+    uint32_t length;
+    /**
+     * Cyfry numeru, po dwie w bajcie.
+     */
+    uint8_t digits[];
+} PackedNumber;
+
+/** @brief Zwraca rozmiar spakowanego numeru.
+ * @param[in] length – liczba cyfr numeru.
+ * @return Liczba bajtów zajmowanych przez spakowany numer o @p length
+ *         cyfrach.
+ */
+static inline size_t packedSize(size_t length) {
+    return sizeof(PackedNumber) + (length + 1) / 2;
+}
+
+/** @brief Zwraca cyfrę spakowanego numeru.
+ * @param[in] number – wskaźnik na spakowany numer;
+ * @param[in] i      – indeks cyfry, mniejszy od długości numeru.
+ * @return Kod cyfry o indeksie @p i.
+ */
+static inline short packedDigit(PackedNumber const *number, size_t i) {
+    uint8_t byte = number->digits[i / 2];
+    return (short) ((i % 2 == 0) ? byte >> 4 : byte & 0x0F);
+}
+
+/** @brief Ustawia cyfrę spakowanego numeru.
+ * Ustawienie cyfry o parzystym indeksie zeruje cyfrę następną, więc
+ * numer skrócony do tej cyfry pozostaje w postaci kanonicznej.
+ * @param[in,out] number – wskaźnik na spakowany numer;
+ * @param[in] i          – indeks cyfry;
+ * @param[in] digit      – kod cyfry.
+ */
+static inline void packedSetDigit(PackedNumber *number, size_t i,
+        short digit) {
+    if (i % 2 == 0) {
+        number->digits[i / 2] = (uint8_t) (digit << 4);
+    }
+    else {
+        number->digits[i / 2] =
+                (uint8_t) ((number->digits[i / 2] & 0xF0) | digit);
+    }
+}
+
+/** @brief Pakuje numer.
+ * Zapisuje w @p number pierwsze @p length cyfr napisu @p num.
+ * Bufor @p number musi mieć co najmniej @ref packedSize(@p length) bajtów.
+ * @param[out] number – wskaźnik na bufor na spakowany numer;
+ * @param[in] num     – wskaźnik na napis reprezentujący numer;
+ * @param[in] length  – liczba pakowanych cyfr.
+ */
+void packedPack(PackedNumber *number, char const *num, size_t length);
+
+/** @brief Tworzy spakowany numer.
+ * Alokuje i wypełnia spakowany numer reprezentujący napis @p num.
+ * @param[in] num – wskaźnik na napis reprezentujący poprawny numer.
+ * @return Wskaźnik na spakowany numer lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PackedNumber * packedFromString(char const *num);
+
+/** @brief Rozpakowuje numer.
+ * Zapisuje cyfry numeru @p number jako napis zakończony znakiem '\\0'.
+ * @param[in] number – wskaźnik na spakowany numer;
+ * @param[out] out   – wskaźnik na bufor o rozmiarze co najmniej długości
+ *                     numeru powiększonej o jeden.
+ * @return Wskaźnik na znak '\\0' zapisany na końcu napisu.
+ */
+char * packedUnpack(PackedNumber const *number, char *out);
+
+/** @brief Sprawdza równość spakowanych numerów.
+ * @param[in] a – wskaźnik na spakowany numer;
+ * @param[in] b – wskaźnik na drugi spakowany numer.
+ * @return Wartość @p true, jeśli numery są równe.
+ *         Wartość @p false, w przeciwnym przypadku.
+ */
+bool packedEqual(PackedNumber const *a, PackedNumber const *b);
+
+/** @brief Sprawdza, czy spakowany numer jest prefiksem innego.
+ * Porównuje całe bajty, czyli po dwie cyfry naraz.
+ * @param[in] prefix – wskaźnik na potencjalny prefiks;
+ * @param[in] number – wskaźnik na numer.
+ * @return Wartość @p true, jeśli @p prefix jest prefiksem @p number.
+ *         Wartość @p false, w przeciwnym przypadku.
+ */
+bool packedIsPrefix(PackedNumber const *prefix, PackedNumber const *number);
+
+/** @brief Porównuje spakowane numery w porządku leksykograficznym.
+ * Cyfry są porównywane według ich wartości, a prefiks numeru
+ * poprzedza ten numer.
+ * @param[in] a – wskaźnik na spakowany numer;
+ * @param[in] b – wskaźnik na drugi spakowany numer.
+ * @return Liczba ujemna, jeśli @p a poprzedza @p b,
+ *         zero, jeśli numery są równe,
+ *         liczba dodatnia, jeśli @p b poprzedza @p a.
+ */
+int packedCompare(PackedNumber const *a, PackedNumber const *b);
+
+#endif /* __NUMBER_H__ */
@@ -0,0 +1,143 @@
+/** @file
+ * Implementacja sortowania numerów telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "number_sort.h"
+
+/**
+ * Liczba kodów znaków: koniec napisu i dwanaście cyfr.
+ */
+#define CODES 13
+
+/**
+ * Rozmiar przedziału, poniżej którego sortujemy przez wstawianie.
+ */
+#define SMALL_RANGE 24
+
+/**
+ * Kody znaków zachowujące porządek numerów: koniec napisu ma kod 0,
+ * cyfry od 0 do 9 kody od 1 do 10, a znaki '*' i '#' kody 11 i 12.
+ */
+static uint8_t const codes[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['*'] = 11, ['#'] = 12,
+};
+
+/** @brief Zwraca kod znaku napisu.
+ * @param[in] key   – wskaźnik na napis;
+ * @param[in] depth – indeks znaku, nie większy od długości napisu.
+ * @return Kod znaku.
+ */
+static inline uint8_t code(char const *key, size_t depth) {
+    return codes[(unsigned char) key[depth]];
+}
+
+/** @brief Przedział tablicy posortowany do zadanej głębokości.
+ * Wszystkie napisy przedziału mają wspólny prefiks długości @p depth.
+ */
+typedef struct SortRange {
+    /**
+     * Indeks pierwszego napisu przedziału.
+     */
+    size_t low;
+    /**
+     * Indeks za ostatnim napisem przedziału.
+     */
+    size_t high;
+    /**
+     * Długość wspólnego prefiksu napisów przedziału.
+     */
+    size_t depth;
+} SortRange;
+
+/** @brief Sortuje krótki przedział przez wstawianie.
+ * @param[in,out] keys – tablica wskaźników na napisy;
+ * @param[in] range    – sortowany przedział.
+ */
+static void insertionSort(char const **keys, SortRange range) {
+    for (size_t i = range.low + 1; i < range.high; i++) {
+        char const *key = keys[i];
+        size_t j = i;
+        while (j > range.low) {
+            char const *other = keys[j - 1];
+            size_t d = range.depth;
+            while (code(key, d) != 0 && code(key, d) == code(other, d)) {
+                d++;
+            }
+            if (code(other, d) <= code(key, d)) {
+                break;
+            }
+            keys[j] = other;
+            j--;
+        }
+        keys[j] = key;
+    }
+}
+
+bool numberSort(char const **keys, size_t count) {
+    SortRange *stack = malloc(CODES * sizeof(SortRange));
+    if (stack == NULL) {
+        return false;
+    }
+    size_t capacity = CODES;
+    size_t size = 0;
+    stack[size++] = (SortRange) {0, count, 0};
+
+    while (size > 0) {
+        SortRange range = stack[--size];
+        if (range.high - range.low < SMALL_RANGE) {
+            insertionSort(keys, range);
+            continue;
+        }
+
+        size_t next[CODES] = {0};
+        size_t end[CODES];
+        for (size_t i = range.low; i < range.high; i++) {
+            next[code(keys[i], range.depth)]++;
+        }
+        size_t start = range.low;
+        for (uint8_t c = 0; c < CODES; c++) {
+            start += next[c];
+            end[c] = start;
+            next[c] = start - next[c];
+        }
+        if (size + CODES > capacity) {
+            capacity *= 2;
+            SortRange *grown = realloc(stack, capacity * sizeof(SortRange));
+            if (grown == NULL) {
+                free(stack);
+                return false;
+            }
+            stack = grown;
+        }
+        for (uint8_t c = 1; c < CODES; c++) {
+            if (end[c] - next[c] > 1) {
+                stack[size++] = (SortRange) {next[c], end[c],
+                        range.depth + 1};
+            }
+        }
+
+        for (uint8_t c = 0; c < CODES; c++) {
+            while (next[c] < end[c]) {
+                char const *key = keys[next[c]];
+                uint8_t k = code(key, range.depth);
+                if (k == c) {
+                    next[c]++;
+                }
+                else {
+                    keys[next[c]] = keys[next[k]];
+                    keys[next[k]++] = key;
+                }
+            }
+        }
+    }
+    free(stack);
+    return true;
+}
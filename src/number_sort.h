@@ -0,0 +1,28 @@
+/** @file
+ * Interfejs sortowania numerów telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __NUMBER_SORT_H__
+#define __NUMBER_SORT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Sortuje numery.
+ * Porządkuje napisy leksykograficznie według wartości cyfr, w którym
+ * prefiks numeru poprzedza ten numer, a znaki '*' i '#' następują po
+ * cyfrze 9. Sortuje pozycyjnie od najstarszej cyfry, w miejscu,
+ * przypisując każdemu znakowi czterobitowy kod zachowujący ten porządek.
+ * @param[in,out] keys – tablica wskaźników na napisy zakończone znakiem
+ *                       '\0', złożone wyłącznie z cyfr;
+ * @param[in] count    – liczba napisów.
+ * @return Wartość @p true, jeśli sortowanie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+bool numberSort(char const **keys, size_t count);
+
+#endif /* __NUMBER_SORT_H__ */
@@ -7,513 +7,3451 @@
  * @date 2022
  */
 
+#define _XOPEN_SOURCE 700
+
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
 #include "phone_forward.h"
+#include "arena.h"
+#include "epoch.h"
+#include "string_pool.h"
+#include "number.h"
+#include "phone_numbers.h"
+#include "reverse_cursor.h"
+#include "snapshot.h"
+
+/**
+ * Maksymalna ilość synów pojedyńczego węzła,
+ * zależna od podstawy używanego systemu liczbowego.
+ */
+#define BASE PHFWD_MAX_CHILDREN
+
+/**
+ * Maksymalna liczba cyfr przechowywanych bezpośrednio w węźle
+ * drzewa przekierowań. Dobrana tak, by nagłówek węzła zajmował 24 bajty.
+ */
+#define RUN_MAX 17
+
+/**
+ * @typedef Node
+ * @brief Węzeł drzewa przekierowań.
+ */
+typedef struct Node Node;
+
+/** @brief Węzeł drzewa przechowującego przekierowania numerów telefonów.
+ * Węzeł drzewa przechowującego cyfrę numeru telefonu, przekierowanie oraz
+ * wskaźniki na synów danego węzła.
+ * Numer odczytujemy jako numery kolejnych ojców danego węzła.
+ * Węzeł przechowuje tylko istniejących synów, w kolejności cyfr,
+ * a maska @p childrenMask mówi, które cyfry mają syna. Indeks syna
+ * w tablicy @p children to liczba zapalonych bitów maski poniżej jego
+ * cyfry. Większość węzłów ma jednego syna, więc taki węzeł zajmuje
+ * kilkukrotnie mniej pamięci niż węzeł z tablicą @ref BASE wskaźników.
+ * Drzewo jest skompresowane: krawędź prowadząca do węzła to cyfra syna
+ * w ojcu, po której następuje ciąg cyfr @p run zapisany w samym węźle.
+ * Przekierowanie i synowie węzła dotyczą numeru kończącego się na
+ * ostatniej cyfrze tego ciągu, więc głębokość drzewa zależy od liczby
+ * rozgałęzień, a nie od długości numerów.
+ */
+struct Node {
+    /** 
+     * Uchwyt w puli napisów numeru, na który mamy przekierowanie,
+     * lub @ref POOL_NONE, jeśli węzeł nie ma przekierowania.
+     */
+    uint32_t forwardNumber;
+    /**
+     * Maska bitowa cyfr, dla których węzeł ma syna.
+     */
+    uint16_t childrenMask;
+    /**
+     * Liczba cyfr w tablicy @p run.
+     */
+    uint8_t runLength;
+    /**
+     * Cyfry krawędzi prowadzącej do węzła, występujące po cyfrze syna
+     * w ojcu.
+     */
+    uint8_t run[RUN_MAX];
+    /**
+     * Tablica wskaźników na istniejących synów danego węzła,
+     * o rozmiarze równym liczbie zapalonych bitów @p childrenMask.
+     */
+    Node *children[];
+};
+
+/**
+ * @typedef ReverseNode
+ * @brief Węzeł drzewa odwrotnych przekierowań.
+ */
+typedef struct ReverseNode ReverseNode;
+
+/** @brief Węzeł drzewa odwrotnych przekierowań.
+ * Drzewo odwrotnych przekierowań jest indeksowane numerami, na które
+ * wykonywane są przekierowania. Węzeł reprezentujący numer @p t
+ * przechowuje wszystkie prefiksy, które są przekierowane na @p t.
+ */
+struct ReverseNode {
+    /**
+     * Tablica spakowanych prefiksów przekierowanych na numer
+     * reprezentowany przez węzeł, posortowana rosnąco.
+     */
+    PackedNumber **sources;
+    /**
+     * Liczba prefiksów w tablicy @p sources.
+     */
+    size_t size;
+    /**
+     * Rozmiar zaalokowanej tablicy @p sources.
+     */
+    size_t capacity;
+    /**
+     * Wskaźnik na ojca węzła lub NULL dla korzenia.
+     */
+    ReverseNode *parent;
+    /**
+     * Tablica wskaźników na dzieci danego węzła.
+     */
+    ReverseNode *children[BASE];
+};
+
+/** @brief Ramka stosu przechodzenia drzewa przekierowań.
+ * Opisuje węzeł oczekujący na odwiedzenie albo, przy schodzeniu ścieżką
+ * usuwanego numeru, węzeł leżący na tej ścieżce.
+ */
+typedef struct Frame {
+    /**
+     * Wskaźnik na węzeł.
+     */
+    Node *node;
+    /**
+     * Wskaźnik na miejsce, w którym przechowywany jest wskaźnik na węzeł.
+     */
+    Node **slot;
+    /**
+     * Długość prefiksu kończącego się przed ciągiem cyfr węzła.
+     */
+    size_t index;
+    /**
+     * Cyfra syna, którym węzeł jest w ojcu, lub -1 dla węzła,
+     * od którego zaczęto przechodzenie.
+     */
+    short digit;
+} Frame;
+
+/** @brief Stos ramek przechodzenia drzewa przekierowań.
+ * Stos należy do struktury przekierowań i jest używany ponownie przez
+ * kolejne operacje, więc zwykle nie wymaga alokacji pamięci.
+ */
+typedef struct NodeStack {
+    /**
+     * Tablica ramek.
+     */
+    Frame *frames;
+    /**
+     * Liczba ramek na stosie.
+     */
+    size_t size;
+    /**
+     * Rozmiar zaalokowanej tablicy ramek.
+     */
+    size_t capacity;
+} NodeStack;
+
+/**
+ * Liczba odłożonych węzłów, po której przekroczeniu piszący czeka
+ * na czytających i zwalnia węzły.
+ */
+#define RECLAIM_BATCH 256
+
+/** @brief Węzeł odłożony do zwolnienia.
+ * Węzeł drzewa przekierowań odłączony od drzewa, ale być może jeszcze
+ * czytany przez inne wątki.
+ */
+typedef struct Retired {
+    /**
+     * Wskaźnik na węzeł.
+     */
+    void *block;
+    /**
+     * Klasa rozmiaru, z której przydzielono węzeł.
+     */
+    unsigned sizeClass;
+} Retired;
+
+/**
+ * Liczba węzłów, które wątek zwalniający zwalnia za jednym zajęciem
+ * blokady piszących.
+ */
+#define RECLAIM_STEP 4096
+
+/** @brief Wątek zwalniający odłączone poddrzewa.
+ * Piszący odkładają korzenie odłączonych poddrzew na stos @p nodes,
+ * a wątek zwalnia je w tle porcjami po @ref RECLAIM_STEP węzłów,
+ * odkładając na stos synów każdego zwalnianego węzła. Stos chroni blokada
+ * piszących struktury, a liczniki @p queued i @p finished oraz flagę
+ * @p stop muteks @p mutex.
+ */
+typedef struct Reclaimer {
+    /**
+     * Wskaźnik na strukturę, której poddrzewa są zwalniane.
+     */
+    struct PhoneForward *pf;
+    /**
+     * Wątek zwalniający.
+     */
+    pthread_t thread;
+    /**
+     * Muteks chroniący liczniki i flagę zatrzymania.
+     */
+    pthread_mutex_t mutex;
+    /**
+     * Zmienna warunkowa budząca wątek zwalniający.
+     */
+    pthread_cond_t wake;
+    /**
+     * Zmienna warunkowa budząca czekających na zwolnienie poddrzew.
+     */
+    pthread_cond_t done;
+    /**
+     * Stos węzłów do zwolnienia.
+     */
+    Node **nodes;
+    /**
+     * Liczba węzłów na stosie.
+     */
+    size_t size;
+    /**
+     * Rozmiar zaalokowanego stosu.
+     */
+    size_t capacity;
+    /**
+     * Liczba odłożonych poddrzew.
+     */
+    uint64_t queued;
+    /**
+     * Liczba poddrzew, o których wiadomo, że zostały zwolnione.
+     */
+    uint64_t finished;
+    /**
+     * Czy wątek ma się zakończyć.
+     */
+    bool stop;
+} Reclaimer;
+
+/** @brief Stan współbieżnego dostępu do struktury.
+ * Wyszukiwania przekierowań tylko oznaczają swoje sekcje krytyczne
+ * w domenie @p epoch. Piszący wykluczają się nawzajem blokadą @p lock,
+ * którą w trybie współdzielonym biorą też funkcje czytające drzewo
+ * odwrotnych przekierowań. Odłączone węzły czekają na liście
+ * @p retired, a usunięte numery w puli, aż żaden czytający nie będzie
+ * mógł ich używać.
+ */
+typedef struct Concurrency {
+    /**
+     * Domena odroczonego zwalniania pamięci.
+     */
+    Epoch epoch;
+    /**
+     * Blokada piszących.
+     */
+    pthread_rwlock_t lock;
+    /**
+     * Tablica węzłów odłożonych do zwolnienia.
+     */
+    Retired *retired;
+    /**
+     * Liczba węzłów w tablicy @p retired.
+     */
+    size_t retiredSize;
+    /**
+     * Rozmiar zaalokowanej tablicy @p retired.
+     */
+    size_t retiredCapacity;
+    /**
+     * Liczby odłożonych węzłów indeksowane klasą rozmiaru.
+     */
+    size_t retiredNodes[BASE + 1];
+    /**
+     * Wątek zwalniający odłączone poddrzewa lub NULL.
+     */
+    Reclaimer *reclaimer;
+} Concurrency;
+
+/** @brief To jest struktura przechowująca
+ * przekierowania numerów telefonów.
+ * Przechowuje korzeń drzewa przekierowań oraz korzeń drzewa odwrotnych
+ * przekierowań, które pozwala wyznaczać wynik funkcji @ref phfwdReverse
+ * bez przechodzenia całego drzewa przekierowań.
+ * Węzły drzewa przekierowań przydzielane są z alokatora @p arena,
+ * w którym klasa rozmiaru węzła to liczba jego synów, a numery,
+ * na które wykonywane są przekierowania, przechowywane są w puli @p pool.
+ * Struktura wczytana funkcją @ref phfwdLoad lub utworzona funkcją
+ * @ref phfwdFreeze nie ma drzew ani puli, tylko obraz @p snapshot,
+ * na który przekazywane są zapytania.
+ * W strukturze utworzonej funkcją @ref phfwdNewConcurrent węzły widoczne
+ * dla czytających nie są zmieniane w miejscu: piszący podmienia je
+ * na kopie atomowym zapisem wskaźnika, a stare węzły zwalnia później.
+ */
+struct PhoneForward {
+    /**
+     * Alokator węzłów drzewa przekierowań.
+     */
+    Arena arena;
+    /**
+     * Pula spakowanych numerów, na które wykonywane są przekierowania.
+     * Wiele prefiksów przekierowanych na ten sam numer współdzieli jeden
+     * numer.
+     */
+    StringPool pool;
+    /**
+     * Korzeń drzewa przekierowań.
+     */
+    Node *root;
+    /**
+     * Korzeń drzewa odwrotnych przekierowań.
+     */
+    ReverseNode *reverseRoot;
+    /**
+     * Stos używany przez operacje przechodzące drzewo przekierowań.
+     */
+    NodeStack stack;
+    /**
+     * Liczba przekierowań.
+     */
+    size_t forwards;
+    /**
+     * Łączna długość numerów, na które wykonywane są przekierowania.
+     */
+    size_t forwardDigits;
+    /**
+     * Łączna długość przekierowywanych prefiksów.
+     */
+    size_t sourceDigits;
+    /**
+     * Liczba węzłów drzewa odwrotnych przekierowań.
+     */
+    size_t reverseNodes;
+    /**
+     * Tablica liczb przekierowań indeksowana długością prefiksu.
+     */
+    size_t *depths;
+    /**
+     * Rozmiar tablicy @p depths.
+     */
+    size_t depthsSize;
+    /**
+     * Długość najdłuższego przekierowywanego prefiksu.
+     */
+    size_t maxDepth;
+    /**
+     * Wskaźnik na obraz, z którego wczytano strukturę, lub NULL.
+     */
+    Snapshot *snapshot;
+    /**
+     * Wskaźnik na stan współbieżnego dostępu lub NULL dla struktury
+     * używanej przez jeden wątek.
+     */
+    Concurrency *concurrency;
+};
+
+/**
+ * @brief Zwraca większy rozmiar tablic.
+ * Zwraca 2 * @p size + 1,
+ * jeśli nie przekroczy to maksymalnego rozmiaru size_t
+ * lub maksymalny rozmiar size_t w przeciwnym przypadku.
+ * @param[in] size – rozmiar, który chcemy odpowienio powiększyć.
+ * @return Nowy, powiększony rozmiar.
+ */
+static size_t newSize(size_t size) {
+    if (size > SIZE_MAX / 2 - 1) return SIZE_MAX;
+    return size * 2 + 1;
+}
+
+/** @brief Tworzy nowy węzeł drzewa przekierowań.
+ * Tworzy węzeł bez przekierowania, bez synów i z pustym ciągiem cyfr.
+ * @param[in,out] arena – wskaźnik na alokator węzłów.
+ * @return Wskaźnik na utworzony węzeł lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+static Node * nodeNew(Arena *arena) {
+    Node *node = arenaAlloc(arena, 0);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->childrenMask = 0;
+    node->runLength = 0;
+    node->forwardNumber = POOL_NONE;
+    return node;
+}
+
+/** @brief Odczytuje wskaźnik na węzeł zapisany przez piszącego.
+ * @param[in] slot – wskaźnik na miejsce, w którym przechowywany jest
+ *                   wskaźnik na węzeł.
+ * @return Wskaźnik na węzeł, którego zawartość jest już widoczna.
+ */
+static inline Node * loadNode(Node * const *slot) {
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+/** @brief Publikuje węzeł.
+ * Zapisuje wskaźnik na węzeł tak, by czytający, który go odczyta,
+ * widział całą wcześniej zapisaną zawartość węzła.
+ * @param[out] slot – wskaźnik na miejsce, w którym przechowywany jest
+ *                    wskaźnik na węzeł.
+ * @param[in] node  – wskaźnik na publikowany węzeł.
+ */
+static inline void storeNode(Node **slot, Node *node) {
+    __atomic_store_n(slot, node, __ATOMIC_RELEASE);
+}
+
+/** @brief Odczytuje przekierowanie węzła.
+ * @param[in] node – wskaźnik na węzeł.
+ * @return Uchwyt przekierowania węzła lub @ref POOL_NONE.
+ */
+static inline uint32_t nodeForward(Node const *node) {
+    return __atomic_load_n(&node->forwardNumber, __ATOMIC_ACQUIRE);
+}
+
+/** @brief Zwraca liczbę synów węzła.
+ * @param[in] node – wskaźnik na węzeł.
+ * @return Liczba synów węzła @p node.
+ */
+static inline unsigned nodeChildrenCount(Node const *node) {
+    return (unsigned) __builtin_popcount(node->childrenMask);
+}
+
+/** @brief Zwraca indeks syna w tablicy synów.
+ * @param[in] node – wskaźnik na węzeł.
+ * @param[in] digit – cyfra syna.
+ * @return Liczba synów węzła @p node o cyfrach mniejszych niż @p digit.
+ */
+static inline unsigned nodeChildIndex(Node const *node, short digit) {
+    return (unsigned) __builtin_popcount(
+            node->childrenMask & ((1u << digit) - 1));
+}
+
+/** @brief Zwraca syna węzła.
+ * @param[in] node – wskaźnik na węzeł.
+ * @param[in] digit – cyfra syna.
+ * @return Wskaźnik na syna węzła @p node odpowiadającego cyfrze @p digit
+ *         lub NULL, jeśli takiego syna nie ma.
+ */
+static inline Node * nodeChild(Node const *node, short digit) {
+    if ((node->childrenMask & (1u << digit)) == 0) {
+        return NULL;
+    }
+    return loadNode(&node->children[nodeChildIndex(node, digit)]);
+}
+
+/** @brief Zwalnia odłożone węzły i numery.
+ * Czeka, aż zakończą się wyszukiwania, które mogły je odczytać,
+ * po czym zwraca węzły do alokatora i zwalnia usunięte numery puli.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void reclaim(PhoneForward *pf) {
+    Concurrency *concurrency = pf->concurrency;
+    epochSynchronize(&concurrency->epoch);
+    for (size_t i = 0; i < concurrency->retiredSize; i++) {
+        Retired const *item = &concurrency->retired[i];
+        arenaFree(&pf->arena, item->sizeClass, item->block);
+    }
+    concurrency->retiredSize = 0;
+    memset(concurrency->retiredNodes, 0, sizeof concurrency->retiredNodes);
+    poolCollect(&pf->pool);
+}
+
+/** @brief Zwalnia odłączony węzeł.
+ * W strukturze używanej przez jeden wątek zwalnia węzeł od razu,
+ * a w pozostałych odkłada go do zwolnienia. Jeśli nie uda się powiększyć
+ * listy odłożonych węzłów, czeka na czytających i zwalnia je wszystkie.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] sizeClass – klasa rozmiaru, z której przydzielono węzeł.
+ * @param[in] node – wskaźnik na węzeł, do którego nie prowadzi już
+ *                   żaden wskaźnik w drzewie.
+ */
+static void nodeFree(PhoneForward *pf, unsigned sizeClass, Node *node) {
+    Concurrency *concurrency = pf->concurrency;
+    if (concurrency != NULL
+            && concurrency->retiredSize == concurrency->retiredCapacity) {
+        size_t capacity = newSize(concurrency->retiredCapacity);
+        Retired *retired = realloc(concurrency->retired,
+                capacity * sizeof(Retired));
+        if (retired == NULL) {
+            reclaim(pf);
+            concurrency = NULL;
+        }
+        else {
+            concurrency->retired = retired;
+            concurrency->retiredCapacity = capacity;
+        }
+    }
+    if (concurrency == NULL) {
+        arenaFree(&pf->arena, sizeClass, node);
+        return;
+    }
+    concurrency->retired[concurrency->retiredSize++] =
+            (Retired) {node, sizeClass};
+    concurrency->retiredNodes[sizeClass]++;
+}
+
+/** @brief Zwraca liczbę węzłów o danej liczbie synów.
+ * Nie liczy węzłów odłożonych do zwolnienia.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] sizeClass – liczba synów.
+ * @return Liczba węzłów drzewa przekierowań o @p sizeClass synach.
+ */
+static size_t liveNodes(PhoneForward const *pf, unsigned sizeClass) {
+    size_t live = pf->arena.pools[sizeClass].live;
+    if (pf->concurrency != NULL) {
+        live -= pf->concurrency->retiredNodes[sizeClass];
+    }
+    return live;
+}
+
+/** @brief Zwalnia odłożone bloki, jeśli jest ich dużo.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void reclaimIfFull(PhoneForward *pf) {
+    if (pf->concurrency != NULL
+            && pf->concurrency->retiredSize >= RECLAIM_BATCH) {
+        reclaim(pf);
+    }
+}
+
+/** @brief Rozpoczyna zmianę struktury.
+ * W strukturze używanej przez wiele wątków czeka na zakończenie zmian
+ * wykonywanych przez inne wątki.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void writeLock(PhoneForward *pf) {
+    if (pf->concurrency != NULL) {
+        pthread_rwlock_wrlock(&pf->concurrency->lock);
+    }
+}
+
+/** @brief Kończy zmianę struktury.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void writeUnlock(PhoneForward *pf) {
+    if (pf->concurrency != NULL) {
+        reclaimIfFull(pf);
+        pthread_rwlock_unlock(&pf->concurrency->lock);
+    }
+}
+
+/** @brief Rozpoczyna odczyt wymagający niezmiennej struktury.
+ * W strukturze używanej przez wiele wątków czeka na zakończenie
+ * trwającej zmiany i wstrzymuje kolejne.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void readLock(PhoneForward const *pf) {
+    if (pf->concurrency != NULL) {
+        pthread_rwlock_rdlock(&pf->concurrency->lock);
+    }
+}
+
+/** @brief Kończy odczyt wymagający niezmiennej struktury.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void readUnlock(PhoneForward const *pf) {
+    if (pf->concurrency != NULL) {
+        pthread_rwlock_unlock(&pf->concurrency->lock);
+    }
+}
+
+/** @brief Rozpoczyna wyszukiwanie przekierowań.
+ * Nie blokuje się. Do wywołania @ref readerExit węzły i numery
+ * odczytane ze struktury nie zostaną zwolnione.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @return Znacznik do przekazania funkcji @ref readerExit.
+ */
+static inline unsigned readerEnter(PhoneForward const *pf) {
+    return pf->concurrency == NULL ? 0 : epochEnter(&pf->concurrency->epoch);
+}
+
+/** @brief Kończy wyszukiwanie przekierowań.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] token – znacznik zwrócony przez @ref readerEnter.
+ */
+static inline void readerExit(PhoneForward const *pf, unsigned token) {
+    if (pf->concurrency != NULL) {
+        epochExit(&pf->concurrency->epoch, token);
+    }
+}
+
+/** @brief Dodaje syna do węzła.
+ * Powiększa węzeł wskazywany przez @p nodePtr o miejsce na nowego syna
+ * i wstawia go na odpowiednią pozycję. Węzeł może zmienić położenie
+ * w pamięci, więc nowy adres zapisywany jest pod @p nodePtr.
+ * Węzeł nie może mieć jeszcze syna dla cyfry @p digit.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in,out] nodePtr – wskaźnik na wskaźnik na węzeł.
+ * @param[in] digit – cyfra syna.
+ * @param[in] child – wskaźnik na dodawanego syna.
+ * @return Wartość @p true, jeśli dodawanie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool nodeAddChild(PhoneForward *pf, Node **nodePtr,
+        short digit, Node *child) {
+    Node *old = *nodePtr;
+    assert((old->childrenMask & (1u << digit)) == 0);
+    unsigned count = nodeChildrenCount(old);
+    Node *node = arenaAlloc(&pf->arena, count + 1);
+    if (node == NULL) {
+        return false;
+    }
+    unsigned index = nodeChildIndex(old, digit);
+    memcpy(node, old, sizeof(Node) + index * sizeof(Node *));
+    node->children[index] = child;
+    memcpy(node->children + index + 1, old->children + index,
+            (count - index) * sizeof(Node *));
+    node->childrenMask |= (uint16_t) (1u << digit);
+    storeNode(nodePtr, node);
+    nodeFree(pf, count, old);
+    return true;
+}
+
+/** @brief Odłącza syna od węzła.
+ * Zastępuje węzeł wskazywany przez @p nodePtr mniejszym węzłem bez
+ * danego syna. Sam syn nie jest usuwany. Jeśli nie uda się przydzielić
+ * mniejszego bloku, syn usuwany jest w miejscu, a węzeł zostaje
+ * w dotychczasowym, większym bloku, co jest bezpieczne przy jego
+ * późniejszym zwalnianiu. W strukturze używanej przez wiele wątków węzeł
+ * nie może być zmieniany w miejscu, więc wtedy syn nie zostaje odłączony.
+ * Nowy adres węzła zapisywany jest pod @p nodePtr.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in,out] nodePtr – wskaźnik na wskaźnik na węzeł.
+ * @param[in] digit – cyfra syna.
+ * @return Wartość @p true, jeśli syn został odłączony.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool nodeRemoveChild(PhoneForward *pf, Node **nodePtr, short digit) {
+    Node *node = *nodePtr;
+    assert((node->childrenMask & (1u << digit)) != 0);
+    unsigned count = nodeChildrenCount(node);
+    unsigned index = nodeChildIndex(node, digit);
+    Node *shrunk = arenaAlloc(&pf->arena, count - 1);
+    if (shrunk == NULL) {
+        if (pf->concurrency != NULL) {
+            return false;
+        }
+        memmove(node->children + index, node->children + index + 1,
+                (count - index - 1) * sizeof(Node *));
+        node->childrenMask &= (uint16_t) ~(1u << digit);
+        return true;
+    }
+    memcpy(shrunk, node, sizeof(Node) + index * sizeof(Node *));
+    memcpy(shrunk->children + index, node->children + index + 1,
+            (count - index - 1) * sizeof(Node *));
+    shrunk->childrenMask &= (uint16_t) ~(1u << digit);
+    storeNode(nodePtr, shrunk);
+    nodeFree(pf, count, node);
+    return true;
+}
+
+/** @brief Tworzy nowy węzeł drzewa odwrotnych przekierowań.
+ * Tworzy węzeł bez prefiksów i bez synów.
+ * @return Wskaźnik na utworzony węzeł lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+static ReverseNode * reverseNodeNew(void) {
+    ReverseNode *node = malloc(sizeof(ReverseNode));
+    if (node == NULL) {
+        return NULL;
+    }
+    for (short i = 0; i < BASE; i++) {
+        node->children[i] = NULL;
+    }
+    node->sources = NULL;
+    node->size = 0;
+    node->capacity = 0;
+    node->parent = NULL;
+    return node;
+}
+
+/** @brief Usuwa drzewo odwrotnych przekierowań.
+ * Usuwa węzeł @p root wraz ze wszystkimi jego potomkami
+ * i przechowywanymi przez nie prefiksami. Schodzi do kolejnych synów,
+ * odłączając ich od ojca, i wraca po wskaźnikach na ojców, więc nie
+ * potrzebuje stosu.
+ * Nic nie robi, jeśli wskaźnik ten ma wartość NULL.
+ * @param[in] root – wskaźnik na korzeń usuwanego drzewa.
+ */
+static void reverseNodeDelete(ReverseNode *root) {
+    ReverseNode *node = root;
+    while (node != NULL) {
+        ReverseNode *child = NULL;
+        for (short i = 0; i < BASE && child == NULL; i++) {
+            child = node->children[i];
+            node->children[i] = NULL;
+        }
+        if (child != NULL) {
+            node = child;
+            continue;
+        }
+
+        ReverseNode *parent = node == root ? NULL : node->parent;
+        for (size_t i = 0; i < node->size; i++) {
+            free(node->sources[i]);
+        }
+        free(node->sources);
+        free(node);
+        node = parent;
+    }
+}
+
+/** @brief Tworzy strukturę bez drzew przekierowań.
+ * Inicjuje alokator, pulę, stos i liczniki, ale nie tworzy korzeni drzew.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+static PhoneForward * phoneForwardAlloc(void) {
+    PhoneForward *pf = malloc(sizeof(PhoneForward));
+    if (pf == NULL) {
+        return NULL;
+    }
+    arenaInit(&pf->arena, sizeof(Node), sizeof(Node *), BASE + 1);
+    poolInit(&pf->pool);
+    pf->stack.frames = NULL;
+    pf->stack.size = 0;
+    pf->stack.capacity = 0;
+    pf->forwards = 0;
+    pf->forwardDigits = 0;
+    pf->sourceDigits = 0;
+    pf->reverseNodes = 1;
+    pf->depths = NULL;
+    pf->depthsSize = 0;
+    pf->maxDepth = 0;
+    pf->root = NULL;
+    pf->reverseRoot = NULL;
+    pf->snapshot = NULL;
+    pf->concurrency = NULL;
+    return pf;
+}
+
+PhoneForward * phfwdNew(void) {
+    PhoneForward *pf = phoneForwardAlloc();
+    if (pf == NULL) {
+        return NULL;
+    }
+    pf->root = nodeNew(&pf->arena);
+    pf->reverseRoot = reverseNodeNew();
+    if (pf->root == NULL || pf->reverseRoot == NULL) {
+        phfwdDelete(pf);
+        return NULL;
+    }
+    return pf;
+}
+
+PhoneForward * phfwdNewConcurrent(void) {
+    PhoneForward *pf = phfwdNew();
+    if (pf == NULL) {
+        return NULL;
+    }
+    Concurrency *concurrency = aligned_alloc(EPOCH_LINE, sizeof(Concurrency));
+    if (concurrency == NULL) {
+        phfwdDelete(pf);
+        return NULL;
+    }
+    if (pthread_rwlock_init(&concurrency->lock, NULL) != 0) {
+        free(concurrency);
+        phfwdDelete(pf);
+        return NULL;
+    }
+    epochInit(&concurrency->epoch);
+    concurrency->retired = NULL;
+    concurrency->retiredSize = 0;
+    concurrency->retiredCapacity = 0;
+    memset(concurrency->retiredNodes, 0, sizeof concurrency->retiredNodes);
+    concurrency->reclaimer = NULL;
+    poolSetDeferred(&pf->pool);
+    pf->concurrency = concurrency;
+    return pf;
+}
+
+/** @brief Zatrzymuje wątek zwalniający.
+ * Nie czeka na zwolnienie odłożonych poddrzew: ich węzły zwolni
+ * @ref arenaRelease razem z pozostałymi.
+ * @param[in,out] reclaimer – wskaźnik na wątek zwalniający lub NULL.
+ */
+static void reclaimerStop(Reclaimer *reclaimer) {
+    if (reclaimer == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&reclaimer->mutex);
+    __atomic_store_n(&reclaimer->stop, true, __ATOMIC_RELAXED);
+    pthread_cond_signal(&reclaimer->wake);
+    pthread_mutex_unlock(&reclaimer->mutex);
+    pthread_join(reclaimer->thread, NULL);
+    pthread_cond_destroy(&reclaimer->done);
+    pthread_cond_destroy(&reclaimer->wake);
+    pthread_mutex_destroy(&reclaimer->mutex);
+    free(reclaimer->nodes);
+    free(reclaimer);
+}
+
+void phfwdDelete(PhoneForward *pf) {
+    if (pf != NULL) {
+        if (pf->concurrency != NULL) {
+            reclaimerStop(pf->concurrency->reclaimer);
+        }
+        arenaRelease(&pf->arena);
+        poolDestroy(&pf->pool);
+        reverseNodeDelete(pf->reverseRoot);
+        free(pf->stack.frames);
+        free(pf->depths);
+        if (pf->snapshot != NULL) {
+            snapshotClose(pf->snapshot);
+            free(pf->snapshot);
+        }
+        if (pf->concurrency != NULL) {
+            pthread_rwlock_destroy(&pf->concurrency->lock);
+            free(pf->concurrency->retired);
+            free(pf->concurrency);
+        }
+        free(pf);
+    }
+}
+
+/** @brief Sprawdza poprawność podanego numeru.
+ * Sprawdza poprawność podanego numeru @p num.
+ * Sprawdza, czy @p num nie jest NULL-em, nie jest pusty lub nie zawiera znaku,
+ * niebędącego cyfrą.
+ * @param[in] num – wskaźnik na sprawdzany napis.
+ * @return Wartość @p true, jeśli napis jest poprawną liczbą.
+ *         Wartość @p false, jeśli napis nie jest poprawną liczbą,
+ *         jest pustym napisem lub wskazuje na NULL.
+ */
+static bool isNumberOk(char const *num) {
+    return numberLength(num) > 0;
+}
+
+/** @brief Szuka prefiksu w węźle drzewa odwrotnych przekierowań.
+ * Wyszukuje binarnie numer @p source w posortowanej tablicy prefiksów.
+ * @param[in] node – wskaźnik na węzeł drzewa odwrotnych przekierowań.
+ * @param[in] source – wskaźnik na szukany spakowany prefiks.
+ * @param[out] position – indeks znalezionego prefiksu albo indeks,
+ *                        pod który należy go wstawić.
+ * @return Wartość @p true, jeśli prefiks jest w węźle.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+static bool reverseNodeFind(ReverseNode const *node,
+        PackedNumber const *source, size_t *position) {
+    size_t low = 0;
+    size_t high = node->size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int result = packedCompare(node->sources[middle], source);
+        if (result == 0) {
+            *position = middle;
+            return true;
+        }
+        if (result < 0) low = middle + 1;
+        else    high = middle;
+    }
+    *position = low;
+    return false;
+}
+
+/** @brief Dodaje prefiks do drzewa odwrotnych przekierowań.
+ * Schodzi w drzewie odwrotnych przekierowań po numerze @p target,
+ * tworząc brakujące węzły, po czym wstawia kopię numeru @p source
+ * do posortowanej tablicy prefiksów węzła reprezentującego @p target.
+ * @param[in,out] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in] target – wskaźnik na spakowany numer, na który wykonywane
+ *                     jest przekierowanie.
+ * @param[in] source – wskaźnik na spakowany prefiks przekierowywanych
+ *                     numerów.
+ * @param[in,out] created – licznik węzłów, zwiększany o liczbę
+ *                          utworzonych węzłów.
+ * @return Wartość @p true, jeśli dodawanie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool reverseIndexAdd(ReverseNode *root,
+        PackedNumber const *target, PackedNumber const *source,
+        size_t *created) {
+    ReverseNode *node = root;
+    for (size_t i = 0; i < target->length; i++) {
+        short digit = packedDigit(target, i);
+        if (node->children[digit] == NULL) {
+            node->children[digit] = reverseNodeNew();
+            if (node->children[digit] == NULL) return false;
+            node->children[digit]->parent = node;
+            (*created)++;
+        }
+        node = node->children[digit];
+    }
+
+    if (node->size == node->capacity) {
+        size_t capacity = newSize(node->capacity);
+        PackedNumber **sources = realloc(node->sources,
+                capacity * sizeof(PackedNumber *));
+        if (sources == NULL) return false;
+        node->sources = sources;
+        node->capacity = capacity;
+    }
+    PackedNumber *copy = malloc(packedSize(source->length));
+    if (copy == NULL) return false;
+    memcpy(copy, source, packedSize(source->length));
+    size_t position;
+    reverseNodeFind(node, source, &position);
+    memmove(node->sources + position + 1, node->sources + position,
+            (node->size - position) * sizeof(PackedNumber *));
+    node->sources[position] = copy;
+    node->size++;
+    return true;
+}
+
+/** @brief Usuwa puste węzły drzewa odwrotnych przekierowań.
+ * Usuwa węzeł @p node i kolejnych jego przodków, dopóki nie mają prefiksów
+ * ani synów.
+ * @param[in,out] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in,out] node – wskaźnik na węzeł, od którego zaczyna.
+ * @param[in,out] nodes – licznik węzłów, zmniejszany o liczbę
+ *                        usuniętych węzłów.
+ */
+static void reverseNodePrune(ReverseNode *root, ReverseNode *node,
+        size_t *nodes) {
+    while (node != root && node->size == 0) {
+        for (short i = 0; i < BASE; i++) {
+            if (node->children[i] != NULL) return;
+        }
+        ReverseNode *parent = node->parent;
+        for (short i = 0; i < BASE; i++) {
+            if (parent->children[i] == node) parent->children[i] = NULL;
+        }
+        free(node->sources);
+        free(node);
+        (*nodes)--;
+        node = parent;
+    }
+}
+
+/** @brief Szuka węzła drzewa odwrotnych przekierowań.
+ * @param[in] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in] target – wskaźnik na spakowany numer.
+ * @return Wskaźnik na węzeł reprezentujący numer @p target lub NULL,
+ *         jeśli go nie ma.
+ */
+static ReverseNode * reverseNodeOf(ReverseNode *root,
+        PackedNumber const *target) {
+    ReverseNode *node = root;
+    for (size_t i = 0; i < target->length && node != NULL; i++) {
+        node = node->children[packedDigit(target, i)];
+    }
+    return node;
+}
+
+/** @brief Usuwa prefiks z drzewa odwrotnych przekierowań.
+ * Usuwa z węzła reprezentującego numer @p target numer równy @p source,
+ * po czym usuwa węzły, które zostały bez prefiksów i bez synów.
+ * Nic nie robi, jeśli takiego numeru nie ma.
+ * @param[in,out] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in] target – wskaźnik na spakowany numer, na który wykonywane
+ *                     jest przekierowanie.
+ * @param[in] source – wskaźnik na spakowany prefiks przekierowywanych
+ *                     numerów.
+ * @param[in,out] nodes – licznik węzłów, zmniejszany o liczbę
+ *                        usuniętych węzłów.
+ */
+static void reverseIndexRemove(ReverseNode *root,
+        PackedNumber const *target, PackedNumber const *source,
+        size_t *nodes) {
+    ReverseNode *node = reverseNodeOf(root, target);
+    if (node == NULL) {
+        return;
+    }
+    size_t position;
+    if (!reverseNodeFind(node, source, &position)) {
+        return;
+    }
+    free(node->sources[position]);
+    node->size--;
+    memmove(node->sources + position, node->sources + position + 1,
+            (node->size - position) * sizeof(PackedNumber *));
+    reverseNodePrune(root, node, nodes);
+}
+
+/** @brief Usuwa z drzewa odwrotnych przekierowań prefiksy o danym
+ *  początku.
+ * Usuwa z węzła reprezentującego numer @p target wszystkie numery,
+ * których prefiksem jest @p prefix. Prefiksy węzła są posortowane, więc
+ * takie numery leżą obok siebie i są usuwane jednym przesunięciem
+ * tablicy, zamiast osobnego przesunięcia dla każdego z nich.
+ * Następnie usuwa węzły, które zostały bez prefiksów i bez synów.
+ * @param[in,out] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in] target – wskaźnik na spakowany numer, na który wykonywane
+ *                     jest przekierowanie.
+ * @param[in] prefix – wskaźnik na spakowany początek usuwanych numerów.
+ * @param[in,out] nodes – licznik węzłów, zmniejszany o liczbę
+ *                        usuniętych węzłów.
+ */
+static void reverseIndexRemovePrefixed(ReverseNode *root,
+        PackedNumber const *target, PackedNumber const *prefix,
+        size_t *nodes) {
+    ReverseNode *node = reverseNodeOf(root, target);
+    if (node == NULL) {
+        return;
+    }
+    size_t first;
+    reverseNodeFind(node, prefix, &first);
+    size_t low = first;
+    size_t high = node->size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (packedIsPrefix(prefix, node->sources[middle])) low = middle + 1;
+        else    high = middle;
+    }
+    if (low == first) {
+        return;
+    }
+    for (size_t i = first; i < low; i++) {
+        free(node->sources[i]);
+    }
+    memmove(node->sources + first, node->sources + low,
+            (node->size - low) * sizeof(PackedNumber *));
+    node->size -= low - first;
+    reverseNodePrune(root, node, nodes);
+}
+
+/** @brief Rozdziela węzeł w połowie jego ciągu cyfr.
+ * Tworzy nowy węzeł przejmujący pierwsze @p k cyfr ciągu węzła
+ * wskazywanego przez @p nodePtr, którego jedynym synem staje się
+ * dotychczasowy węzeł z pozostałymi cyframi, a w strukturze używanej
+ * przez wiele wątków jego kopia. Nowy węzeł zapisywany jest
+ * pod @p nodePtr.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in,out] nodePtr – wskaźnik na wskaźnik na rozdzielany węzeł.
+ * @param[in] k – liczba cyfr pozostających w górnym węźle,
+ *                mniejsza od długości ciągu.
+ * @return Wartość @p true, jeśli rozdzielenie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool nodeSplit(PhoneForward *pf, Node **nodePtr, uint8_t k) {
+    Node *lower = *nodePtr;
+    assert(k < lower->runLength);
+    Node *upper = arenaAlloc(&pf->arena, 1);
+    if (upper == NULL) {
+        return false;
+    }
+    unsigned count = nodeChildrenCount(lower);
+    Node *copy = lower;
+    if (pf->concurrency != NULL) {
+        copy = arenaAlloc(&pf->arena, count);
+        if (copy == NULL) {
+            arenaFree(&pf->arena, 1, upper);
+            return false;
+        }
+        memcpy(copy, lower, sizeof(Node) + count * sizeof(Node *));
+    }
+    short digit = lower->run[k];
+    upper->forwardNumber = POOL_NONE;
+    upper->childrenMask = (uint16_t) (1u << digit);
+    upper->runLength = k;
+    memcpy(upper->run, lower->run, k);
+    upper->children[0] = copy;
+    copy->runLength = (uint8_t) (lower->runLength - k - 1);
+    memmove(copy->run, lower->run + k + 1, copy->runLength);
+    storeNode(nodePtr, upper);
+    if (copy != lower) {
+        nodeFree(pf, count, lower);
+    }
+    return true;
+}
+
+/** @brief Scala węzeł z jego jedynym synem.
+ * Jeśli węzeł wskazywany przez @p nodePtr nie ma przekierowania,
+ * ma dokładnie jednego syna, a ich ciągi cyfr zmieszczą się w jednym
+ * węźle, to zastępuje oba węzły jednym. W strukturze używanej przez
+ * wiele wątków tym węzłem jest kopia syna, a jeśli nie uda się jej
+ * przydzielić, węzły nie są scalane.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in,out] nodePtr – wskaźnik na wskaźnik na węzeł.
+ */
+static void nodeMergeWithChild(PhoneForward *pf, Node **nodePtr) {
+    Node *node = *nodePtr;
+    if (node->forwardNumber != POOL_NONE || nodeChildrenCount(node) != 1) {
+        return;
+    }
+    Node *child = node->children[0];
+    if (node->runLength + 1 + child->runLength > RUN_MAX) {
+        return;
+    }
+    unsigned count = nodeChildrenCount(child);
+    Node *merged = child;
+    if (pf->concurrency != NULL) {
+        merged = arenaAlloc(&pf->arena, count);
+        if (merged == NULL) {
+            return;
+        }
+        memcpy(merged, child, sizeof(Node) + count * sizeof(Node *));
+    }
+    memmove(merged->run + node->runLength + 1, child->run, child->runLength);
+    memcpy(merged->run, node->run, node->runLength);
+    merged->run[node->runLength] = (uint8_t) __builtin_ctz(node->childrenMask);
+    merged->runLength = (uint8_t) (child->runLength + node->runLength + 1);
+    storeNode(nodePtr, merged);
+    nodeFree(pf, 1, node);
+    if (merged != child) {
+        nodeFree(pf, count, child);
+    }
+}
+
+/** @brief Wkłada ramkę na stos.
+ * @param[in,out] stack – wskaźnik na stos.
+ * @param[in] frame – wkładana ramka.
+ * @return Wartość @p true, jeśli włożenie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool stackPush(NodeStack *stack, Frame frame) {
+    if (stack->size == stack->capacity) {
+        size_t capacity = newSize(stack->capacity);
+        Frame *frames = realloc(stack->frames, capacity * sizeof(Frame));
+        if (frames == NULL) {
+            return false;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
+    stack->frames[stack->size++] = frame;
+    return true;
+}
+
+/** @brief Ustawia przekierowanie prefiksu.
+ * Zastępuje przekierowanie zapisane pod @p forwardNumber przekierowaniem
+ * na numer @p target, uaktualniając pulę, drzewo odwrotnych przekierowań
+ * i liczniki statystyk.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in,out] forwardNumber – wskaźnik na uchwyt przekierowania węzła
+ *                                prefiksu @p source.
+ * @param[in] source – wskaźnik na spakowany prefiks.
+ * @param[in] target – wskaźnik na spakowany numer, na który tworzymy
+ *                     przekierowanie.
+ * @return Wartość @p true, jeśli ustawienie przekierowania się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool setForward(PhoneForward *pf, uint32_t *forwardNumber,
+        PackedNumber const *source, PackedNumber const *target) {
+    if (source->length >= pf->depthsSize) {
+        size_t depthsSize = source->length + 1 > newSize(pf->depthsSize)
+                ? source->length + 1 : newSize(pf->depthsSize);
+        size_t *depths = realloc(pf->depths, depthsSize * sizeof(size_t));
+        if (depths == NULL) return false;
+        memset(depths + pf->depthsSize, 0,
+                (depthsSize - pf->depthsSize) * sizeof(size_t));
+        pf->depths = depths;
+        pf->depthsSize = depthsSize;
+    }
+
+    uint32_t handle = poolIntern(&pf->pool, target,
+            packedSize(target->length));
+    if (handle == POOL_NONE) return false;
+    if (!reverseIndexAdd(pf->reverseRoot, target, source,
+                &pf->reverseNodes)) {
+        poolRelease(&pf->pool, handle);
+        return false;
+    }
+    uint32_t previous = *forwardNumber;
+    if (previous != POOL_NONE) {
+        PackedNumber const *old = poolGet(&pf->pool, previous);
+        pf->forwardDigits -= old->length;
+        reverseIndexRemove(pf->reverseRoot, old, source, &pf->reverseNodes);
+    }
+    else {
+        pf->forwards++;
+        pf->sourceDigits += source->length;
+        pf->depths[source->length]++;
+        if (source->length > pf->maxDepth) {
+            pf->maxDepth = source->length;
+        }
+    }
+    pf->forwardDigits += target->length;
+    __atomic_store_n(forwardNumber, handle, __ATOMIC_RELEASE);
+    poolRelease(&pf->pool, previous);
+    return true;
+}
+
+/** @brief Dodaje przekierowanie numeru telefonu.
+ * Schodzi odpowiednio w drzewie przekierowań,
+ * po czym dodaje odpowiednie węzły, aż do węzła reprezentującego
+ * @ p num1, w którym zapisuje @ p num2. Jeśli @p num1 kończy się lub
+ * rozchodzi w środku ciągu cyfr węzła, węzeł jest rozdzielany.
+ * Brakujące cyfry dodawane są węzłami mieszczącymi po @ref RUN_MAX cyfr.
+ * Uaktualnia też drzewo odwrotnych przekierowań.
+ * Zejście może zacząć się w środku drzewa, od miejsca zapamiętanego przy
+ * dodawaniu numeru o tym samym prefiksie długości @p i.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num1 – wskaźnik na numer, będący prefiksem przekierowań.
+ * @param[in] source – wskaźnik na spakowany numer @p num1.
+ * @param[in] target – wskaźnik na spakowany numer, na który tworzymy
+ *                     przekierowanie.
+ * @param[in,out] nodePtr – wskaźnik na miejsce, w którym przechowywany
+ *                          jest wskaźnik na węzeł, od którego zaczynamy.
+ * @param[in] i – długość prefiksu @p num1 kończącego się przed ciągiem
+ *                cyfr tego węzła.
+ * @param[in,out] path – wskaźnik na stos, na który odkładane są ramki
+ *                       odwiedzanych węzłów, lub NULL.
+ * @return Wartość @p true, jeśli dodawanie przekierowania się powiodło.
+ *         Wartość @p false, w przeciwnym przypadku.
+ */
+static bool addPhoneForward(PhoneForward *pf, char const *num1,
+        PackedNumber const *source, PackedNumber const *target,
+        Node **nodePtr, size_t i, NodeStack *path) {
+    while (true) {
+        if (path != NULL
+                && !stackPush(path, (Frame) {*nodePtr, nodePtr, i, -1})) {
+            return false;
+        }
+        Node *node = *nodePtr;
+        uint8_t k = 0;
+        while (k < node->runLength && num1[i] != '\0'
+                && charToInt(num1[i]) == node->run[k]) {
+            k++;
+            i++;
+        }
+        if (k < node->runLength) {
+            if (!nodeSplit(pf, nodePtr, k)) return false;
+            node = *nodePtr;
+        }
+        if (num1[i] == '\0') {
+            break;
+        }
+
+        short digit = charToInt(num1[i]);
+        i++;
+        if (nodeChild(node, digit) == NULL) {
+            Node *child = nodeNew(&pf->arena);
+            if (child == NULL) return false;
+            while (child->runLength < RUN_MAX && num1[i] != '\0') {
+                child->run[child->runLength++] =
+                        (uint8_t) charToInt(num1[i++]);
+            }
+            i -= child->runLength;
+            if (!nodeAddChild(pf, nodePtr, digit, child)) {
+                arenaFree(&pf->arena, 0, child);
+                return false;
+            }
+            node = *nodePtr;
+        }
+        nodePtr = &node->children[nodeChildIndex(node, digit)];
+    }
+
+    return setForward(pf, &(*nodePtr)->forwardNumber, source, target);
+}
+
+/**
+ * @brief Funkcja odwiedzająca węzeł przy przechodzeniu poddrzewa.
+ * Dostaje strukturę przekierowań, odwiedzany węzeł, bufor z prefiksem
+ * kończącym się na ostatniej cyfrze ciągu cyfr węzła (lub NULL), długość
+ * tego prefiksu oraz dodatkowe dane przekazane do @ref subtreeWalk.
+ * Synowie węzła są już wtedy na stosie, więc węzeł można zwolnić.
+ */
+typedef void (*NodeVisitor)(PhoneForward *pf, Node *node,
+        PackedNumber *prefix, size_t end, void *data);
+
+/** @brief Przechodzi poddrzewo bez rekurencji.
+ * Odwiedza w porządku prefiksowym wszystkie węzły poddrzewa o korzeniu
+ * @p root, używając stosu struktury przekierowań ponad ramkami już na nim
+ * leżącymi. Jeśli @p prefix nie jest NULL-em, odtwarza w nim prefiks
+ * każdego odwiedzanego węzła. Kolejne przejścia tego samego poddrzewa
+ * potrzebują tyle samo miejsca na stosie, więc jeśli jedno się powiodło,
+ * następne nie zawiodą z braku pamięci.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] root – wskaźnik na korzeń poddrzewa.
+ * @param[in] index – długość prefiksu kończącego się przed ciągiem cyfr
+ *                    węzła @p root.
+ * @param[in,out] prefix – wskaźnik na bufor z tym prefiksem, wystarczająco
+ *                         długi dla całego poddrzewa, lub NULL.
+ * @param[in] visit – funkcja odwiedzająca węzły.
+ * @param[in,out] data – dodatkowe dane przekazywane do @p visit.
+ * @return Wartość @p true, jeśli przejście się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool subtreeWalk(PhoneForward *pf, Node *root, size_t index,
+        PackedNumber *prefix, NodeVisitor visit, void *data) {
+    NodeStack *stack = &pf->stack;
+    size_t base = stack->size;
+    if (!stackPush(stack, (Frame) {root, NULL, index, -1})) {
+        return false;
+    }
+    while (stack->size > base) {
+        Frame frame = stack->frames[--stack->size];
+        Node *node = frame.node;
+        size_t end = frame.index + node->runLength;
+        if (prefix != NULL) {
+            if (frame.digit >= 0) {
+                packedSetDigit(prefix, frame.index - 1, frame.digit);
+            }
+            for (uint8_t k = 0; k < node->runLength; k++) {
+                packedSetDigit(prefix, frame.index + k, node->run[k]);
+            }
+        }
+        uint16_t mask = node->childrenMask;
+        for (unsigned i = nodeChildrenCount(node); i-- > 0;) {
+            short digit = (short) (31 - __builtin_clz(mask));
+            mask &= (uint16_t) ~(1u << digit);
+            if (!stackPush(stack,
+                        (Frame) {node->children[i], NULL, end + 1, digit})) {
+                stack->size = base;
+                return false;
+            }
+        }
+        visit(pf, node, prefix, end, data);
+    }
+    return true;
+}
+
+/** @brief Nic nie robi.
+ * Funkcja typu @ref NodeVisitor. Przejście poddrzewa z tą funkcją tylko
+ * zapewnia miejsce na stosie dla kolejnych przejść.
+ * @param[in] pf – nieużywany.
+ * @param[in] node – nieużywany.
+ * @param[in] prefix – nieużywany.
+ * @param[in] end – nieużywany.
+ * @param[in] data – nieużywany.
+ */
+static void visitNothing(PhoneForward *pf, Node *node,
+        PackedNumber *prefix, size_t end, void *data) {
+    (void) pf;
+    (void) node;
+    (void) prefix;
+    (void) end;
+    (void) data;
+}
+
+/** @brief Usuwa przekierowanie węzła z drzewa odwrotnych przekierowań.
+ * Funkcja typu @ref NodeVisitor. Usuwa za jednym razem wszystkie
+ * przekierowania usuwanego poddrzewa na ten sam numer, więc przy kolejnych
+ * takich przekierowaniach nie ma już czego usuwać. Uaktualnia też
+ * liczniki statystyk.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] node – wskaźnik na odwiedzany węzeł.
+ * @param[in] prefix – nieużywany.
+ * @param[in] end – długość prefiksu węzła.
+ * @param[in] data – wskaźnik na spakowany prefiks korzenia usuwanego
+ *                   poddrzewa, wspólny dla wszystkich jego przekierowań.
+ */
+static void visitUnindex(PhoneForward *pf, Node *node,
+        PackedNumber *prefix, size_t end, void *data) {
+    (void) prefix;
+    if (node->forwardNumber != POOL_NONE) {
+        PackedNumber const *target = poolGet(&pf->pool, node->forwardNumber);
+        reverseIndexRemovePrefixed(pf->reverseRoot, target, data,
+                &pf->reverseNodes);
+        pf->forwards--;
+        pf->forwardDigits -= target->length;
+        pf->sourceDigits -= end;
+        pf->depths[end]--;
+    }
+}
+
+/** @brief Zwalnia węzeł.
+ * Funkcja typu @ref NodeVisitor. Zwalnia odwołanie do napisu
+ * przekierowania i zwraca pamięć węzła do alokatora.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] node – wskaźnik na odwiedzany węzeł.
+ * @param[in] prefix – nieużywany.
+ * @param[in] end – nieużywany.
+ * @param[in] data – nieużywany.
+ */
+static void visitDelete(PhoneForward *pf, Node *node,
+        PackedNumber *prefix, size_t end, void *data) {
+    (void) prefix;
+    (void) end;
+    (void) data;
+    poolRelease(&pf->pool, node->forwardNumber);
+    nodeFree(pf, nodeChildrenCount(node), node);
+}
+
+/** @brief Zapewnia miejsce na stosie wątku zwalniającego.
+ * @param[in,out] reclaimer – wskaźnik na wątek zwalniający;
+ * @param[in] extra         – liczba węzłów, które mają się zmieścić.
+ * @return Wartość @p true, jeśli na stosie jest tyle miejsca.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool reclaimerReserve(Reclaimer *reclaimer, size_t extra) {
+    if (reclaimer->capacity - reclaimer->size >= extra) {
+        return true;
+    }
+    size_t capacity = newSize(reclaimer->capacity);
+    if (capacity < reclaimer->size + extra) {
+        capacity = reclaimer->size + extra;
+    }
+    Node **nodes = realloc(reclaimer->nodes, capacity * sizeof(Node *));
+    if (nodes == NULL) {
+        return false;
+    }
+    reclaimer->nodes = nodes;
+    reclaimer->capacity = capacity;
+    return true;
+}
+
+/** @brief Zwalnia porcję odłożonych węzłów.
+ * Wymaga blokady piszących. Jeśli zabraknie pamięci na odłożenie synów
+ * węzła, ich poddrzewa zostaną zwolnione dopiero razem ze strukturą.
+ * @param[in,out] reclaimer – wskaźnik na wątek zwalniający.
+ * @return Wartość @p true, jeśli stos jest pusty.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+static bool reclaimerStep(Reclaimer *reclaimer) {
+    PhoneForward *pf = reclaimer->pf;
+    for (size_t n = 0; n < RECLAIM_STEP && reclaimer->size > 0; n++) {
+        Node *node = reclaimer->nodes[--reclaimer->size];
+        unsigned count = nodeChildrenCount(node);
+        if (reclaimerReserve(reclaimer, count)) {
+            for (unsigned i = 0; i < count; i++) {
+                reclaimer->nodes[reclaimer->size++] = node->children[i];
+            }
+        }
+        poolRelease(&pf->pool, node->forwardNumber);
+        nodeFree(pf, count, node);
+    }
+    return reclaimer->size == 0;
+}
+
+/** @brief Główna pętla wątku zwalniającego.
+ * Czeka na odłożone poddrzewa i zwalnia je porcjami, za każdym razem
+ * zwalniając blokadę piszących, by zmiany struktury nie czekały długo.
+ * Po opróżnieniu stosu budzi czekających w @ref phfwdReclaimerFlush.
+ * @param[in,out] arg – wskaźnik na wątek zwalniający.
+ * @return Wartość NULL.
+ */
+static void * reclaimerRun(void *arg) {
+    Reclaimer *reclaimer = arg;
+    pthread_mutex_lock(&reclaimer->mutex);
+    while (true) {
+        while (!reclaimer->stop && reclaimer->finished == reclaimer->queued) {
+            pthread_cond_wait(&reclaimer->wake, &reclaimer->mutex);
+        }
+        if (reclaimer->stop) {
+            break;
+        }
+        uint64_t queued = reclaimer->queued;
+        pthread_mutex_unlock(&reclaimer->mutex);
+        bool empty = false;
+        while (!empty && !__atomic_load_n(&reclaimer->stop, __ATOMIC_RELAXED)) {
+            writeLock(reclaimer->pf);
+            empty = reclaimerStep(reclaimer);
+            writeUnlock(reclaimer->pf);
+        }
+        pthread_mutex_lock(&reclaimer->mutex);
+        if (empty) {
+            reclaimer->finished = queued;
+            pthread_cond_broadcast(&reclaimer->done);
+        }
+    }
+    pthread_mutex_unlock(&reclaimer->mutex);
+    return NULL;
+}
+
+/** @brief Zwalnia odłączone poddrzewo.
+ * Jeśli struktura ma wątek zwalniający, odkłada tylko korzeń poddrzewa
+ * i budzi ten wątek. W przeciwnym przypadku, albo gdy nie uda się
+ * odłożyć korzenia, zwalnia poddrzewo od razu.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] node – wskaźnik na korzeń odłączonego poddrzewa.
+ * @param[in] index – długość prefiksu kończącego się przed ciągiem cyfr
+ *                    węzła @p node.
+ */
+static void subtreeRelease(PhoneForward *pf, Node *node, size_t index) {
+    Reclaimer *reclaimer =
+            pf->concurrency != NULL ? pf->concurrency->reclaimer : NULL;
+    if (reclaimer != NULL && reclaimerReserve(reclaimer, 1)) {
+        reclaimer->nodes[reclaimer->size++] = node;
+        pthread_mutex_lock(&reclaimer->mutex);
+        reclaimer->queued++;
+        pthread_cond_signal(&reclaimer->wake);
+        pthread_mutex_unlock(&reclaimer->mutex);
+        return;
+    }
+    subtreeWalk(pf, node, index, NULL, visitDelete, NULL);
+}
+
+/** @brief Usuwa poddrzewo wraz z jego przekierowaniami.
+ * Odłącza poddrzewo o korzeniu @p node od ojca, po czym usuwa z drzewa
+ * odwrotnych przekierowań wszystkie jego przekierowania i zwalnia samo
+ * poddrzewo funkcją @ref subtreeRelease, być może w tle. Wszystkie
+ * przekierowania poddrzewa zaczynają się prefiksem korzenia, więc
+ * w każdym węźle drzewa odwrotnych przekierowań zajmują ciągły przedział
+ * i są z niego usuwane naraz. Pierwsze przejście zapewnia miejsce
+ * na stosie dla kolejnych, a poddrzewo jest odłączane dopiero po
+ * przydzieleniu bufora na prefiks, więc jest usuwane w całości albo
+ * wcale.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] node – wskaźnik na korzeń usuwanego poddrzewa.
+ * @param[in,out] parentPtr – wskaźnik na wskaźnik na ojca węzła @p node.
+ * @param[in] digit – cyfra węzła @p node w ojcu.
+ * @param[in] num – wskaźnik na napis, którego pierwsze @p lenght cyfr
+ *                  to prefiks kończący się przed ciągiem cyfr @p node.
+ * @param[in] lenght – długość tego prefiksu.
+ * @return Wartość @p true, jeśli poddrzewo zostało usunięte.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool removeSubtree(PhoneForward *pf, Node *node, Node **parentPtr,
+        short digit, char const *num, size_t lenght) {
+    if (!subtreeWalk(pf, node, lenght, NULL, visitNothing, NULL)) {
+        return false;
+    }
+    size_t end = lenght + node->runLength;
+    PackedNumber *prefix = malloc(packedSize(end));
+    if (prefix == NULL) {
+        return false;
+    }
+    if (!nodeRemoveChild(pf, parentPtr, digit)) {
+        free(prefix);
+        return false;
+    }
+    packedPack(prefix, num, lenght);
+    for (uint8_t k = 0; k < node->runLength; k++) {
+        packedSetDigit(prefix, lenght + k, node->run[k]);
+    }
+    prefix->length = (uint32_t) end;
+    subtreeWalk(pf, node, lenght, NULL, visitUnindex, prefix);
+    free(prefix);
+    subtreeRelease(pf, node, lenght);
+    return true;
+}
+
+/** @brief Usuwa przekierowania.
+ * Usuwa przekierowania, których parametr @p num jest prefiksem.
+ * Schodzi ścieżką numeru @p num, odkładając jej węzły na stos, aż do
+ * węzła, którego całe poddrzewo należy usunąć. Następnie wraca
+ * po stosie: węzły, które zostały bez przekierowania i synów, są usuwane,
+ * a pierwszy pozostały węzeł scalany ze swoim jedynym synem,
+ * jeśli to możliwe. Pusty węzeł, którego nie udało się odłączyć z braku
+ * pamięci, zostaje w drzewie, co nie zmienia wyników zapytań.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num – wskaźnik na sprawdzany napis.
+ * @param[in] lenght – długość napisu @p num, większa od zera.
+ */
+static void phoneForwardRemove(PhoneForward *pf,
+        char const *num, size_t lenght) {
+    NodeStack *stack = &pf->stack;
+    size_t base = stack->size;
+    Node **slot = &pf->root;
+    short digit = -1;
+    size_t i = 0;
+    while (true) {
+        if (!stackPush(stack, (Frame) {*slot, slot, i, digit})) {
+            stack->size = base;
+            return;
+        }
+        Node *node = *slot;
+        for (uint8_t k = 0; k < node->runLength && i < lenght; k++, i++) {
+            if (charToInt(num[i]) != node->run[k]) {
+                stack->size = base;
+                return;
+            }
+        }
+        if (i == lenght) {
+            break;
+        }
+        digit = charToInt(num[i]);
+        if (nodeChild(node, digit) == NULL) {
+            stack->size = base;
+            return;
+        }
+        slot = &node->children[nodeChildIndex(node, digit)];
+        i++;
+    }
+
+    Frame removed = stack->frames[--stack->size];
+    assert(removed.digit >= 0);
+    if (!removeSubtree(pf, removed.node, stack->frames[stack->size - 1].slot,
+                removed.digit, num, removed.index)) {
+        stack->size = base;
+        return;
+    }
+    while (stack->size > base) {
+        Frame parent = stack->frames[--stack->size];
+        Node *node = *parent.slot;
+        if (parent.digit < 0) {
+            break;
+        }
+        if (node->forwardNumber != POOL_NONE
+                || nodeChildrenCount(node) != 0) {
+            nodeMergeWithChild(pf, parent.slot);
+            break;
+        }
+        if (!nodeRemoveChild(pf, stack->frames[stack->size - 1].slot,
+                    parent.digit)) {
+            break;
+        }
+        nodeFree(pf, 0, node);
+    }
+    stack->size = base;
+    while (pf->maxDepth > 0 && pf->depths[pf->maxDepth] == 0) {
+        pf->maxDepth--;
+    }
+}
+
+bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
+    if (pf == NULL || pf->snapshot != NULL) {
+        return false;
+    }
+    if (!isNumberOk(num1) || !isNumberOk(num2) || !strcmp(num1, num2)) {
+        return false;
+    }
+
+    PackedNumber *source = packedFromString(num1);
+    PackedNumber *target = packedFromString(num2);
+    writeLock(pf);
+    bool result = source != NULL && target != NULL
+            && addPhoneForward(pf, num1, source, target, &pf->root, 0, NULL);
+    if (!result) {
+        phoneForwardRemove(pf, num1, numberLength(num1));
+    }
+    writeUnlock(pf);
+    free(source);
+    free(target);
+    return result;
+}
+
+void phfwdRemove(PhoneForward *pf, char const *num) {
+    size_t lenght = numberLength(num);
+    if (pf == NULL || lenght == 0 || pf->snapshot != NULL) {
+        return;
+    }
+    writeLock(pf);
+    phoneForwardRemove(pf, num, lenght);
+    writeUnlock(pf);
+}
+
+bool phfwdReclaimerStart(PhoneForward *pf) {
+    if (pf == NULL || pf->concurrency == NULL) {
+        return false;
+    }
+    writeLock(pf);
+    if (pf->concurrency->reclaimer != NULL) {
+        writeUnlock(pf);
+        return true;
+    }
+    Reclaimer *reclaimer = malloc(sizeof(Reclaimer));
+    bool ok = reclaimer != NULL;
+    if (ok) {
+        *reclaimer = (Reclaimer) {.pf = pf};
+        ok = pthread_mutex_init(&reclaimer->mutex, NULL) == 0;
+    }
+    if (ok && pthread_cond_init(&reclaimer->wake, NULL) != 0) {
+        pthread_mutex_destroy(&reclaimer->mutex);
+        ok = false;
+    }
+    if (ok && pthread_cond_init(&reclaimer->done, NULL) != 0) {
+        pthread_cond_destroy(&reclaimer->wake);
+        pthread_mutex_destroy(&reclaimer->mutex);
+        ok = false;
+    }
+    if (ok && pthread_create(&reclaimer->thread, NULL, reclaimerRun,
+                reclaimer) != 0) {
+        pthread_cond_destroy(&reclaimer->done);
+        pthread_cond_destroy(&reclaimer->wake);
+        pthread_mutex_destroy(&reclaimer->mutex);
+        ok = false;
+    }
+    if (ok) {
+        pf->concurrency->reclaimer = reclaimer;
+    }
+    else {
+        free(reclaimer);
+    }
+    writeUnlock(pf);
+    return ok;
+}
+
+void phfwdReclaimerFlush(PhoneForward const *pf) {
+    if (pf == NULL || pf->concurrency == NULL) {
+        return;
+    }
+    readLock(pf);
+    Reclaimer *reclaimer = pf->concurrency->reclaimer;
+    readUnlock(pf);
+    if (reclaimer == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&reclaimer->mutex);
+    uint64_t queued = reclaimer->queued;
+    while (reclaimer->finished < queued) {
+        pthread_cond_wait(&reclaimer->done, &reclaimer->mutex);
+    }
+    pthread_mutex_unlock(&reclaimer->mutex);
+}
+
+/**
+ * Początkowy rozmiar bufora, do którego czytany jest importowany plik.
+ */
+#define IMPORT_BUFFER (1 << 16)
+
+/** @brief Stan importu przekierowań.
+ * Pamięta numer z ostatniego dodanego wiersza i ramki węzłów jego ścieżki
+ * w drzewie, od których zaczyna się zejście dla kolejnego wiersza, oraz
+ * bufory na spakowane numery, używane ponownie przez kolejne wiersze.
+ */
+typedef struct Importer {
+    /**
+     * Wskaźnik na strukturę, do której dodawane są przekierowania.
+     */
+    PhoneForward *pf;
+    /**
+     * Ramki węzłów ścieżki ostatnio dodanego numeru.
+     */
+    NodeStack path;
+    /**
+     * Ostatnio dodany numer.
+     */
+    char *previous;
+    /**
+     * Długość numeru @p previous.
+     */
+    size_t previousLength;
+    /**
+     * Bufor na spakowany prefiks i, za nim, spakowany numer docelowy.
+     */
+    PackedNumber *packed;
+    /**
+     * Rozmiar bufora @p packed w bajtach; bufor @p previous ma go tyle
+     * samo.
+     */
+    size_t capacity;
+    /**
+     * Podsumowanie importu.
+     */
+    PhoneForwardImport summary;
+} Importer;
+
+/** @brief Zapewnia miejsce na numery wiersza w buforach importu.
+ * @param[in,out] importer – wskaźnik na stan importu.
+ * @param[in] length – łączna długość numerów wiersza.
+ * @return Wartość @p true, jeśli bufory są wystarczająco duże.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool importerReserve(Importer *importer, size_t length) {
+    size_t size = 2 * packedSize(length) + sizeof(uint32_t) + length;
+    if (size <= importer->capacity) {
+        return true;
+    }
+    PackedNumber *packed = malloc(size);
+    char *previous = malloc(size);
+    if (packed == NULL || previous == NULL) {
+        free(packed);
+        free(previous);
+        return false;
+    }
+    if (importer->previousLength > 0) {
+        memcpy(previous, importer->previous, importer->previousLength);
+    }
+    free(importer->packed);
+    free(importer->previous);
+    importer->packed = packed;
+    importer->previous = previous;
+    importer->capacity = size;
+    return true;
+}
+
+/** @brief Sprawdza, czy znak oddziela pola wiersza.
+ * @param[in] c – sprawdzany znak.
+ * @return Wartość @p true, jeśli znak to spacja, tabulator lub znak
+ *         powrotu karetki.
+ */
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/** @brief Zapamiętuje niepoprawny wiersz.
+ * @param[in,out] importer – wskaźnik na stan importu.
+ */
+static void importerError(Importer *importer) {
+    PhoneForwardImport *summary = &importer->summary;
+    summary->errors++;
+    if (summary->firstError == 0) {
+        summary->firstError = summary->lines;
+    }
+    summary->lastError = summary->lines;
+}
+
+/** @brief Dodaje przekierowanie z jednego wiersza.
+ * Dzieli wiersz na pola w miejscu, zastępując odstępy znakami '\0'.
+ * Zejście w drzewie zaczyna od najgłębszej ramki ścieżki poprzedniego
+ * numeru, która leży na wspólnym prefiksie obu numerów.
+ * @param[in,out] importer – wskaźnik na stan importu.
+ * @param[in,out] line – wskaźnik na wiersz; znak za wierszem musi być
+ *                       znakiem '\0'.
+ * @param[in] length – długość wiersza bez znaku nowego wiersza.
+ * @return Wartość @p true, jeśli wiersz został przetworzony.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool importLine(Importer *importer, char *line, size_t length) {
+    importer->summary.lines++;
+    char *fields[2];
+    size_t count = 0;
+    size_t k = 0;
+    while (count <= 2) {
+        while (k < length && isBlank(line[k])) k++;
+        if (k == length) break;
+        if (count < 2) fields[count] = line + k;
+        count++;
+        while (k < length && !isBlank(line[k])) k++;
+        if (k < length) line[k++] = '\0';
+    }
+    if (count == 0) {
+        return true;
+    }
+    size_t len1 = count == 2 ? numberLength(fields[0]) : 0;
+    size_t len2 = count == 2 ? numberLength(fields[1]) : 0;
+    if (len1 == 0 || len2 == 0 || !strcmp(fields[0], fields[1])) {
+        importerError(importer);
+        return true;
+    }
+    char const *num1 = fields[0];
+    if (!importerReserve(importer, len1 + len2)) {
+        return false;
+    }
+    PackedNumber *source = importer->packed;
+    size_t offset = (packedSize(len1) + sizeof(uint32_t) - 1)
+            / sizeof(uint32_t) * sizeof(uint32_t);
+    PackedNumber *target = (PackedNumber *) ((char *) source + offset);
+    packedPack(source, num1, len1);
+    packedPack(target, fields[1], len2);
+
+    size_t common = 0;
+    while (common < len1 && common < importer->previousLength
+            && importer->previous[common] == num1[common]) {
+        common++;
+    }
+    NodeStack *path = &importer->path;
+    while (path->size > 0 && path->frames[path->size - 1].index > common) {
+        path->size--;
+    }
+    Node **slot = &importer->pf->root;
+    size_t i = 0;
+    if (path->size > 0) {
+        Frame frame = path->frames[--path->size];
+        slot = frame.slot;
+        i = frame.index;
+    }
+    if (!addPhoneForward(importer->pf, num1, source, target, slot, i, path)) {
+        path->size = 0;
+        importer->previousLength = 0;
+        phoneForwardRemove(importer->pf, num1, len1);
+        return false;
+    }
+    memcpy(importer->previous, num1, len1);
+    importer->previousLength = len1;
+    importer->summary.added++;
+    reclaimIfFull(importer->pf);
+    return true;
+}
+
+bool phfwdImport(PhoneForward *pf, int fd, PhoneForwardImport *result) {
+    Importer importer = {pf, {NULL, 0, 0}, NULL, 0, NULL, 0, {0, 0, 0, 0, 0}};
+    size_t capacity = IMPORT_BUFFER;
+    char *buffer = NULL;
+    bool ok = pf != NULL && pf->snapshot == NULL;
+    if (ok) {
+        buffer = malloc(capacity + 1);
+        ok = buffer != NULL;
+    }
+    if (ok) {
+        writeLock(pf);
+    }
+
+    size_t start = 0;
+    size_t end = 0;
+    bool eof = false;
+    while (ok) {
+        char *newline = memchr(buffer + start, '\n', end - start);
+        if (newline != NULL) {
+            size_t length = (size_t) (newline - (buffer + start));
+            *newline = '\0';
+            ok = importLine(&importer, buffer + start, length);
+            start += length + 1;
+            continue;
+        }
+        if (eof) {
+            if (end > start) {
+                buffer[end] = '\0';
+                ok = importLine(&importer, buffer + start, end - start);
+            }
+            break;
+        }
+        if (start > 0) {
+            memmove(buffer, buffer + start, end - start);
+            end -= start;
+            start = 0;
+        }
+        else if (end == capacity) {
+            capacity = newSize(capacity);
+            char *grown = realloc(buffer, capacity + 1);
+            if (grown == NULL) {
+                ok = false;
+                break;
+            }
+            buffer = grown;
+        }
+        ssize_t got = read(fd, buffer + end, capacity - end);
+        if (got < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+        eof = got == 0;
+        end += (size_t) got;
+    }
+
+    if (buffer != NULL) {
+        writeUnlock(pf);
+    }
+    free(buffer);
+    free(importer.path.frames);
+    free(importer.previous);
+    free(importer.packed);
+    if (result != NULL) {
+        *result = importer.summary;
+    }
+    return ok;
+}
+
+bool phfwdImportFile(PhoneForward *pf, char const *path,
+        PhoneForwardImport *result) {
+    int fd = path == NULL ? -1 : open(path, O_RDONLY);
+    if (pf == NULL || fd < 0) {
+        if (fd >= 0) close(fd);
+        if (result != NULL) {
+            *result = (PhoneForwardImport) {0, 0, 0, 0, 0};
+        }
+        return false;
+    }
+    bool ok = phfwdImport(pf, fd, result);
+    close(fd);
+    return ok;
+}
+
+/** @brief Otwarty węzeł budowanego drzewa przekierowań.
+ * Węzeł leży na ścieżce ostatnio dodanego prefiksu i może jeszcze
+ * dostać synów, więc nie jest jeszcze przydzielony z alokatora; jego
+ * zamknięci synowie czekają w tablicy @p children.
+ */
+typedef struct BuildFrame {
+    /**
+     * Zamknięci synowie węzła indeksowani cyframi.
+     */
+    Node *children[BASE];
+    /**
+     * Maska bitowa cyfr, dla których węzeł ma syna.
+     */
+    uint16_t childrenMask;
+    /**
+     * Cyfra syna, którym węzeł jest w ojcu, lub -1 dla korzenia.
+     */
+    short digit;
+    /**
+     * Uchwyt przekierowania węzła lub @ref POOL_NONE.
+     */
+    uint32_t forwardNumber;
+    /**
+     * Długość prefiksu kończącego się przed ciągiem cyfr węzła.
+     */
+    size_t start;
+    /**
+     * Długość prefiksu węzła, czyli indeks za ostatnią cyfrą jego ciągu.
+     */
+    size_t end;
+} BuildFrame;
+
+/** @brief Zamyka otwarty węzeł budowanego drzewa.
+ * Przydziela węzeł z alokatora, gdy znana jest już liczba jego synów,
+ * więc węzły poddrzewa leżą w alokatorze przed swoim ojcem. Ciąg cyfr
+ * dłuższy niż @ref RUN_MAX dzielony jest na łańcuch węzłów o jednym synu.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] frame – wskaźnik na zamykany węzeł.
+ * @param[in] num – wskaźnik na numer z poddrzewa węzła.
+ * @return Wskaźnik na górny węzeł łańcucha lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+static Node * buildClose(PhoneForward *pf, BuildFrame const *frame,
+        char const *num) {
+    unsigned count = (unsigned) __builtin_popcount(frame->childrenMask);
+    Node *node = arenaAlloc(&pf->arena, count);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->forwardNumber = frame->forwardNumber;
+    node->childrenMask = frame->childrenMask;
+    unsigned index = 0;
+    for (short d = 0; d < BASE; d++) {
+        if (frame->childrenMask & (1u << d)) {
+            node->children[index++] = frame->children[d];
+        }
+    }
+
+    size_t end = frame->end;
+    while (true) {
+        size_t start = end - frame->start > RUN_MAX
+                ? end - RUN_MAX : frame->start;
+        node->runLength = (uint8_t) (end - start);
+        for (size_t k = start; k < end; k++) {
+            node->run[k - start] = (uint8_t) charToInt(num[k]);
+        }
+        if (start == frame->start) {
+            return node;
+        }
+        Node *upper = arenaAlloc(&pf->arena, 1);
+        if (upper == NULL) {
+            return NULL;
+        }
+        short digit = charToInt(num[start - 1]);
+        upper->forwardNumber = POOL_NONE;
+        upper->childrenMask = (uint16_t) (1u << digit);
+        upper->children[0] = node;
+        node = upper;
+        end = start - 1;
+    }
+}
+
+/** @brief Wkłada otwarty węzeł na stos budowy.
+ * @param[in,out] frames – wskaźnik na tablicę otwartych węzłów.
+ * @param[in,out] size – liczba otwartych węzłów.
+ * @param[in,out] capacity – rozmiar tablicy @p frames.
+ * @param[in] digit – cyfra węzła w ojcu.
+ * @param[in] start – długość prefiksu przed ciągiem cyfr węzła.
+ * @param[in] end – długość prefiksu węzła.
+ * @return Wskaźnik na włożony węzeł lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+static BuildFrame * buildPush(BuildFrame **frames, size_t *size,
+        size_t *capacity, short digit, size_t start, size_t end) {
+    if (*size == *capacity) {
+        size_t grown = newSize(*capacity);
+        BuildFrame *resized = realloc(*frames, grown * sizeof(BuildFrame));
+        if (resized == NULL) {
+            return NULL;
+        }
+        *frames = resized;
+        *capacity = grown;
+    }
+    BuildFrame *frame = &(*frames)[(*size)++];
+    frame->childrenMask = 0;
+    frame->digit = digit;
+    frame->forwardNumber = POOL_NONE;
+    frame->start = start;
+    frame->end = end;
+    return frame;
+}
+
+/** @brief Buduje drzewo przekierowań z posortowanych prefiksów.
+ * Przechodzi prefiksy raz, trzymając na stosie otwarte węzły ścieżki
+ * ostatniego prefiksu. Przed dodaniem kolejnego prefiksu zamyka węzły
+ * leżące głębiej niż jego wspólny prefiks z poprzednim, w razie potrzeby
+ * tworząc węzeł rozgałęzienia w środku ciągu cyfr.
+ * @param[in,out] pf – wskaźnik na pustą strukturę bez drzewa przekierowań.
+ * @param[in] sources – tablica poprawnych, posortowanych prefiksów.
+ * @param[in] targets – tablica poprawnych numerów docelowych.
+ * @param[in] count – liczba przekierowań.
+ * @param[in,out] packed – bufor mieszczący dwa spakowane numery
+ *                         z jednego przekierowania.
+ * @return Wartość @p true, jeśli budowa się powiodła.
+ *         Wartość @p false, jeśli prefiksy nie są posortowane lub nie
+ *         udało się alokować pamięci.
+ */
+static bool buildTree(PhoneForward *pf, char const * const *sources,
+        char const * const *targets, size_t count, PackedNumber *packed) {
+    BuildFrame *frames = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    bool ok = buildPush(&frames, &size, &capacity, -1, 0, 0) != NULL;
+    char const *prev = "";
+    size_t prevLength = 0;
+
+    for (size_t r = 0; ok && r < count; r++) {
+        char const *num = sources[r];
+        size_t length = numberLength(num);
+        size_t common = 0;
+        while (common < length && common < prevLength
+                && num[common] == prev[common]) {
+            common++;
+        }
+        if (common == length ? length != prevLength
+                : (common < prevLength
+                    && charToInt(num[common]) < charToInt(prev[common]))) {
+            ok = false;
+            break;
+        }
+
+        while (ok && frames[size - 1].end > common) {
+            BuildFrame closed = frames[--size];
+            BuildFrame *top = &frames[size - 1];
+            if (top->end < common) {
+                short digit = charToInt(prev[top->end]);
+                size_t start = top->end + 1;
+                top = buildPush(&frames, &size, &capacity, digit, start,
+                        common);
+                if (top == NULL) {
+                    ok = false;
+                    break;
+                }
+                closed.start = common + 1;
+                closed.digit = charToInt(prev[common]);
+            }
+            Node *node = buildClose(pf, &closed, prev);
+            if (node == NULL) {
+                ok = false;
+                break;
+            }
+            top->children[closed.digit] = node;
+            top->childrenMask |= (uint16_t) (1u << closed.digit);
+        }
+
+        BuildFrame *frame = &frames[size - 1];
+        if (ok && common < length) {
+            frame = buildPush(&frames, &size, &capacity,
+                    charToInt(num[common]), common + 1, length);
+            ok = frame != NULL;
+        }
+        if (ok) {
+            size_t lenTarget = numberLength(targets[r]);
+            PackedNumber *target = (PackedNumber *) ((char *) packed
+                    + (packedSize(length) + 3) / 4 * 4);
+            packedPack(packed, num, length);
+            packedPack(target, targets[r], lenTarget);
+            ok = setForward(pf, &frame->forwardNumber, packed, target);
+        }
+        prev = num;
+        prevLength = length;
+    }
+
+    while (ok && size > 1) {
+        BuildFrame closed = frames[--size];
+        Node *node = buildClose(pf, &closed, prev);
+        ok = node != NULL;
+        if (ok) {
+            frames[size - 1].children[closed.digit] = node;
+            frames[size - 1].childrenMask |= (uint16_t) (1u << closed.digit);
+        }
+    }
+    if (ok) {
+        pf->root = buildClose(pf, &frames[0], prev);
+        ok = pf->root != NULL;
+    }
+    free(frames);
+    return ok;
+}
+
+PhoneForward * phfwdBuild(char const * const *sources,
+        char const * const *targets, size_t count) {
+    if ((sources == NULL || targets == NULL) && count > 0) {
+        return NULL;
+    }
+    size_t longest = 0;
+    for (size_t r = 0; r < count; r++) {
+        size_t len1 = numberLength(sources[r]);
+        size_t len2 = numberLength(targets[r]);
+        if (len1 == 0 || len2 == 0 || !strcmp(sources[r], targets[r])) {
+            return NULL;
+        }
+        if (len1 + len2 > longest) {
+            longest = len1 + len2;
+        }
+    }
+
+    PhoneForward *pf = phoneForwardAlloc();
+    PackedNumber *packed = malloc(2 * packedSize(longest) + 3);
+    bool ok = pf != NULL && packed != NULL;
+    if (ok) {
+        pf->reverseRoot = reverseNodeNew();
+        ok = pf->reverseRoot != NULL
+                && buildTree(pf, sources, targets, count, packed);
+    }
+    free(packed);
+    if (!ok) {
+        phfwdDelete(pf);
+        return NULL;
+    }
+    return pf;
+}
+
+/**
+ * Liczba wyszukiwań przeplatanych przez funkcję @ref phfwdGetBatch.
+ */
+#define BATCH_LANES 8
+
+/** @brief Stan wyszukiwania przekierowania numeru.
+ * Pozwala przechodzić drzewo przekierowań po numerze krok po kroku,
+ * po jednym węźle, dzięki czemu można przeplatać kilka wyszukiwań.
+ */
+typedef struct Lookup {
+    /**
+     * Wskaźnik na następny odwiedzany węzeł lub NULL po zakończeniu.
+     */
+    Node const *node;
+    /**
+     * Wskaźnik na numer, którego przekierowania szukamy.
+     */
+    char const *num;
+    /**
+     * Długość numeru @p num.
+     */
+    size_t length;
+    /**
+     * Indeks w @p num pierwszej cyfry ciągu cyfr węzła @p node.
+     */
+    size_t i;
+    /**
+     * Uchwyt ostatniego napotkanego przekierowania lub @ref POOL_NONE.
+     */
+    uint32_t forwardNumber;
+    /**
+     * Długość prefiksu numeru @p num, dla którego znaleziono
+     * przekierowanie @p forwardNumber.
+     */
+    size_t j;
+} Lookup;
+
+/** @brief Rozpoczyna wyszukiwanie przekierowania numeru.
+ * @param[out] lookup – wskaźnik na stan wyszukiwania.
+ * @param[in] root – wskaźnik na korzeń drzewa przekierowań.
+ * @param[in] num – wskaźnik na numer, którego przekierowania szukamy.
+ * @param[in] length – długość numeru @p num.
+ */
+static inline void lookupStart(Lookup *lookup, Node const *root,
+        char const *num, size_t length) {
+    lookup->node = root;
+    lookup->num = num;
+    lookup->length = length;
+    lookup->i = 0;
+    lookup->forwardNumber = POOL_NONE;
+    lookup->j = 0;
+}
+
+/** @brief Wykonuje krok wyszukiwania przekierowania.
+ * Przechodzi przez bieżący węzeł, zapamiętując jego przekierowanie,
+ * i wyznacza następny węzeł, prosząc procesor o wcześniejsze pobranie
+ * go do pamięci podręcznej.
+ * @param[in,out] lookup – wskaźnik na stan wyszukiwania.
+ * @return Wartość @p true, jeśli wyszukiwanie trwa dalej.
+ *         Wartość @p false, jeśli się zakończyło.
+ */
+static inline bool lookupStep(Lookup *lookup) {
+    Node const *node = lookup->node;
+    char const *num = lookup->num;
+    size_t i = lookup->i;
+    lookup->node = NULL;
+    for (uint8_t k = 0; k < node->runLength; k++, i++) {
+        if (i == lookup->length || charToInt(num[i]) != node->run[k]) {
+            return false;
+        }
+    }
+    uint32_t forwardNumber = nodeForward(node);
+    if (forwardNumber != POOL_NONE) {
+        lookup->forwardNumber = forwardNumber;
+        lookup->j = i;
+    }
+    if (i == lookup->length) {
+        return false;
+    }
+    node = nodeChild(node, charToInt(num[i]));
+    if (node == NULL) {
+        return false;
+    }
+    __builtin_prefetch(node);
+    lookup->node = node;
+    lookup->i = i + 1;
+    return true;
+}
+
+/** @brief Wyznacza długość wyniku wyszukiwania przekierowania.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] lookup – wskaźnik na stan zakończonego wyszukiwania.
+ * @param[out] lenSuffix – długość reszty szukanego numeru, doklejanej
+ *                         do numeru, na który znaleziono przekierowanie.
+ * @return Liczba cyfr wyniku.
+ */
+static size_t lookupLength(PhoneForward const *pf, Lookup const *lookup,
+        size_t *lenSuffix) {
+    *lenSuffix = lookup->length - lookup->j;
+    if (lookup->forwardNumber == POOL_NONE) {
+        return *lenSuffix;
+    }
+    PackedNumber const *pn = poolGet(&pf->pool, lookup->forwardNumber);
+    return pn->length + *lenSuffix;
+}
+
+/** @brief Zapisuje wynik wyszukiwania przekierowania.
+ * Skleja numer, na który znaleziono przekierowanie, z resztą szukanego
+ * numeru albo kopiuje szukany numer, jeśli przekierowania nie znaleziono.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] lookup – wskaźnik na stan zakończonego wyszukiwania.
+ * @param[in] lenSuffix – długość reszty szukanego numeru.
+ * @param[out] out – wskaźnik na bufor mieszczący wynik i znak '\0'.
+ */
+static void lookupWrite(PhoneForward const *pf, Lookup const *lookup,
+        size_t lenSuffix, char *out) {
+    if (lookup->forwardNumber != POOL_NONE) {
+        out = packedUnpack(poolGet(&pf->pool, lookup->forwardNumber), out);
+    }
+    memcpy(out, lookup->num + lookup->j, lenSuffix + 1);
+}
+
+/** @brief Dopisuje wynik wyszukiwania przekierowania do ciągu numerów.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] lookup – wskaźnik na stan zakończonego wyszukiwania.
+ * @param[in,out] pnums – wskaźnik na ciąg numerów.
+ * @param[in] idx – indeks pozycji w @p pnums, na której zapisujemy wynik.
+ * @return Wartość @p true, jeśli wynik został zapisany.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool lookupStore(PhoneForward const *pf, Lookup const *lookup,
+        PhoneNumbers *pnums, size_t idx) {
+    size_t lenSuffix;
+    size_t len = lookupLength(pf, lookup, &lenSuffix);
+    char *out = phnumSet(pnums, idx, len);
+    if (out == NULL) {
+        return false;
+    }
+    lookupWrite(pf, lookup, lenSuffix, out);
+    return true;
+}
+
+PhoneNumbers * phfwdGet(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    size_t length = numberLength(num);
+    if (length == 0) {
+        return phnumNew(0, 0);
+    }
+    if (pf->snapshot != NULL) {
+        return snapshotGet(pf->snapshot, num, length);
+    }
+
+    unsigned token = readerEnter(pf);
+    Lookup lookup;
+    lookupStart(&lookup, loadNode(&pf->root), num, length);
+    while (lookupStep(&lookup)) {
+    }
+    size_t lenSuffix;
+    size_t len = lookupLength(pf, &lookup, &lenSuffix);
+    PhoneNumbers *pnums = phnumNew(1, len + 1);
+    if (pnums != NULL) {
+        lookupWrite(pf, &lookup, lenSuffix, phnumAppend(pnums, len));
+    }
+    readerExit(pf, token);
+    return pnums;
+}
+
+size_t phfwdGetInto(PhoneForward const *pf, char const *num,
+        char *buf, size_t cap) {
+    size_t length = numberLength(num);
+    if (pf == NULL || length == 0) {
+        if (buf != NULL && cap > 0) buf[0] = '\0';
+        return 0;
+    }
+    if (pf->snapshot != NULL) {
+        return snapshotGetInto(pf->snapshot, num, length, buf, cap);
+    }
+
+    unsigned token = readerEnter(pf);
+    Lookup lookup;
+    lookupStart(&lookup, loadNode(&pf->root), num, length);
+    while (lookupStep(&lookup)) {
+    }
+    size_t lenSuffix;
+    size_t len = lookupLength(pf, &lookup, &lenSuffix);
+    if (buf != NULL && len < cap) {
+        lookupWrite(pf, &lookup, lenSuffix, buf);
+    }
+    else if (buf != NULL && cap > 0) {
+        buf[0] = '\0';
+    }
+    readerExit(pf, token);
+    return len;
+}
+
+PhoneNumbers * phfwdGetBatch(PhoneForward const *pf,
+        char const * const *nums, size_t count) {
+    if (pf == NULL || (nums == NULL && count > 0)) {
+        return NULL;
+    }
+    size_t bufferSize = 0;
+    for (size_t q = 0; q < count; q++) {
+        if (nums[q] != NULL) {
+            bufferSize += strlen(nums[q]) + 1;
+        }
+    }
+    PhoneNumbers *pnums = phnumNew(count, bufferSize);
+    if (pnums == NULL) {
+        return NULL;
+    }
+    for (size_t q = 0; q < count; q++) {
+        phnumAppendNone(pnums);
+    }
+    if (pf->snapshot != NULL) {
+        for (size_t q = 0; q < count; q++) {
+            size_t length = numberLength(nums[q]);
+            if (length > 0 && !snapshotGetAt(pf->snapshot, nums[q], length,
+                        pnums, q)) {
+                phnumDelete(pnums);
+                return NULL;
+            }
+        }
+        return pnums;
+    }
+
+    unsigned token = readerEnter(pf);
+    Node const *root = loadNode(&pf->root);
+    Lookup lanes[BATCH_LANES];
+    size_t queries[BATCH_LANES];
+    size_t active = 0;
+    size_t next = 0;
+    bool ok = true;
+    while (ok && (active > 0 || next < count)) {
+        while (active < BATCH_LANES && next < count) {
+            size_t length = numberLength(nums[next]);
+            if (length > 0) {
+                lookupStart(&lanes[active], root, nums[next], length);
+                queries[active++] = next;
+            }
+            next++;
+        }
+        for (size_t l = 0; l < active;) {
+            if (lookupStep(&lanes[l])) {
+                l++;
+                continue;
+            }
+            ok = ok && lookupStore(pf, &lanes[l], pnums, queries[l]);
+            active--;
+            lanes[l] = lanes[active];
+            queries[l] = queries[active];
+        }
+    }
+    readerExit(pf, token);
+    if (!ok) {
+        phnumDelete(pnums);
+        return NULL;
+    }
+    return pnums;
+}
+
+/**
+ * @brief Szacuje rozmiar wyniku funkcji @ref phfwdReverse.
+ * Schodzi w drzewie odwrotnych przekierowań po numerze @p num i zlicza
+ * znalezione prefiksy oraz długości numerów, które z nich powstaną.
+ * @param[in] root – wskaźnik na korzeń drzewa odwrotnych przekierowań.
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @param[in] lenNum – długość numeru @p num.
+ * @param[out] count – liczba znalezionych numerów.
+ * @param[out] chars – łączna długość znalezionych numerów
+ *                     razem z kończącymi je znakami '\0'.
+ */
+static void reverseSize(ReverseNode const *root, char const *num,
+        size_t lenNum, size_t *count, size_t *chars) {
+    ReverseNode const *node = root;
+    *count = 0;
+    *chars = 0;
+    for (size_t index = 0; index < lenNum; index++) {
+        node = node->children[charToInt(num[index])];
+        if (node == NULL) {
+            break;
+        }
+        for (size_t i = 0; i < node->size; i++) {
+            *chars += node->sources[i]->length + lenNum - index;
+        }
+        *count += node->size;
+    }
+}
+
+/**
+ * @brief Sprawdza, czy numer zbudowany z prefiksu jest przekierowywany
+ *  właśnie przez ten prefiks.
+ * Schodzi w drzewie przekierowań po cyfrach numeru @p source, a potem
+ * numeru @p suffix, bez sklejania ich w jeden napis. Prefiks @p source
+ * ma przekierowanie, więc numer jest przekierowywany przez niego wtedy
+ * i tylko wtedy, gdy żaden dłuższy prefiks numeru nie ma przekierowania.
+ * @param[in] root – wskaźnik na korzeń drzewa przekierowań.
+ * @param[in] source – wskaźnik na spakowany prefiks z przekierowaniem.
+ * @param[in] suffix – wskaźnik na napis doklejany do prefiksu.
+ * @param[in] lenSuffix – długość napisu @p suffix.
+ * @return Wartość @p true, jeśli najdłuższym prefiksem numeru
+ *         z przekierowaniem jest @p source.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+static bool forwardedBy(Node const *root, PackedNumber const *source,
+        char const *suffix, size_t lenSuffix) {
+    size_t lenSource = source->length;
+    size_t length = lenSource + lenSuffix;
+    Node const *node = root;
+    size_t i = 0;
+    while (true) {
+        for (uint8_t k = 0; k < node->runLength; k++, i++) {
+            if (i == length) return true;
+            short digit = i < lenSource ? packedDigit(source, i)
+                : charToInt(suffix[i - lenSource]);
+            if (digit != node->run[k]) return true;
+        }
+        if (i > lenSource && node->forwardNumber != POOL_NONE) {
+            return false;
+        }
+        if (i == length) return true;
+        short digit = i < lenSource ? packedDigit(source, i)
+            : charToInt(suffix[i - lenSource]);
+        node = nodeChild(node, digit);
+        if (node == NULL) return true;
+        i++;
+    }
+}
+
+/**
+ * @brief Kończy wyznaczanie wyniku funkcji @ref phfwdReverse
+ *  lub @ref phfwdGetReverse.
+ * Dopisuje do znalezionych numerów sam numer @p num, jeśli należy on
+ * do wyniku, po czym porządkuje numery funkcją @ref phnumOrderStreams.
+ * Zwalnia tablicę @p stream, a w razie błędu także ciąg @p pn.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num – wskaźnik na napis reprezentujący poprawny numer.
+ * @param[in] lenNum – długość numeru @p num.
+ * @param[in] verify – czy zostawić tylko numery, które są przekierowywane
+ *                     na numer @p num.
+ * @param[in,out] pn – wskaźnik na ciąg znalezionych numerów z wolną
+ *                     pozycją i miejscem na numer @p num.
+ * @param[in,out] stream – tablica numerów strumieni kolejnych numerów
+ *                         ciągu z miejscem na jeszcze jeden.
+ * @param[in] streams – liczba strumieni.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+static PhoneNumbers * reverseFinish(PhoneForward const *pf,
+        char const *num, size_t lenNum, bool verify, PhoneNumbers *pn,
+        size_t *stream, size_t streams) {
+    bool identity = !verify;
+    if (verify) {
+        Lookup lookup;
+        lookupStart(&lookup, loadNode(&pf->root), num, lenNum);
+        while (lookupStep(&lookup)) {
+        }
+        identity = lookup.forwardNumber == POOL_NONE;
+    }
+    if (identity) {
+        stream[pn->size] = streams++;
+        memcpy(phnumAppend(pn, lenNum), num, lenNum + 1);
+    }
+
+    bool ok = phnumOrderStreams(pn, stream, streams);
+    free(stream);
+    if (!ok) {
+        phnumDelete(pn);
+        return NULL;
+    }
+    return pn;
+}
+
+/**
+ * @brief Znajduje numery,
+ *  które powinny być zawarte w wyniku funkcji @ref phfwdReverse
+ *  lub @ref phfwdGetReverse.
+ * Schodzi w drzewie odwrotnych przekierowań po numerze @p num.
+ * Każdy węzeł na tej ścieżce reprezentuje prefiks numeru @p num,
+ * więc każdy zapisany w nim prefiks, po doklejeniu reszty numeru @p num,
+ * jest szukanym numerem. Koszt jest więc proporcjonalny do długości
+ * numeru i liczby znalezionych numerów, a nie do rozmiaru drzewa
+ * przekierowań.
+ *
+ * Prefiksy w węźle są posortowane, a doklejenie tej samej reszty nie
+ * zmienia kolejności prefiksów, z których żaden nie jest prefiksem
+ * drugiego. Prefiksy węzła dzielimy więc na poziomy według liczby ich
+ * prefiksów zapisanych w tym samym węźle; każdy poziom daje posortowany
+ * strumień numerów, a wynik powstaje przez scalenie strumieni funkcją
+ * @ref phnumOrderStreams.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num – wskaźnik na napis reprezentujący poprawny numer.
+ * @param[in] lenNum – długość numeru @p num.
+ * @param[in] verify – czy zostawić tylko numery, które są przekierowywane
+ *                     na numer @p num.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+static PhoneNumbers * reverseCollect(PhoneForward const *pf,
+        char const *num, size_t lenNum, bool verify) {
+    size_t count, chars;
+    reverseSize(pf->reverseRoot, num, lenNum, &count, &chars);
+    PhoneNumbers *pn = phnumNew(count + 1, chars + lenNum + 1);
+    size_t *stream = malloc(2 * (count + 1) * sizeof(size_t));
+    if (pn == NULL || stream == NULL) {
+        phnumDelete(pn);
+        free(stream);
+        return NULL;
+    }
+    size_t *ancestors = stream + count + 1;
+
+    size_t streams = 0;
+    ReverseNode const *node = pf->reverseRoot;
+    for (size_t index = 0; index < lenNum; index++) {
+        node = node->children[charToInt(num[index])];
+        if (node == NULL) {
+            break;
+        }
+        char const *suffix = num + index + 1;
+        size_t lenSuffix = lenNum - index - 1;
+        size_t levels = 0;
+        size_t depth = 0;
+        for (size_t i = 0; i < node->size; i++) {
+            PackedNumber const *source = node->sources[i];
+            while (depth > 0 && !packedIsPrefix(
+                        node->sources[ancestors[depth - 1]], source)) {
+                depth--;
+            }
+            ancestors[depth++] = i;
+            if (depth > levels) {
+                levels = depth;
+            }
+            if (!verify
+                    || forwardedBy(pf->root, source, suffix, lenSuffix)) {
+                stream[pn->size] = streams + depth - 1;
+                char *out = phnumAppend(pn, source->length + lenSuffix);
+                memcpy(packedUnpack(source, out), suffix, lenSuffix + 1);
+            }
+        }
+        streams += levels;
+    }
+    return reverseFinish(pf, num, lenNum, verify, pn, stream, streams);
+}
+
+PhoneNumbers * phfwdReverse(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    size_t length = numberLength(num);
+    if (length == 0) {
+        return phnumNew(0, 0);
+    }
+    if (pf->snapshot != NULL) {
+        return snapshotReverse(pf->snapshot, num, length, false);
+    }
+    readLock(pf);
+    PhoneNumbers *pnums = reverseCollect(pf, num, length, false);
+    readUnlock(pf);
+    return pnums;
+}
+
+PhoneNumbers * phfwdGetReverse(PhoneForward const *pf, char const *num) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    size_t length = numberLength(num);
+    if (length == 0) {
+        return phnumNew(0, 0);
+    }
+    if (pf->snapshot != NULL) {
+        return snapshotReverse(pf->snapshot, num, length, true);
+    }
+    readLock(pf);
+    PhoneNumbers *pnums = reverseCollect(pf, num, length, true);
+    readUnlock(pf);
+    return pnums;
+}
 
 /**
- * Maksymalna ilość synów pojedyńczego węzła,
- * zależna od podstawy używanego systemu liczbowego.
+ * Najmniejsza liczba znalezionych prefiksów, od której zapytanie odwrotne
+ * dzielone jest między wątki.
  */
-#define BASE 12
+#define PARALLEL_MIN 4096
 
-/** @brief To jest struktura przechowująca
- * przekierowania numerów telefonów.
- * Węzeł drzewa przechowującego cyfrę numeru telefonu, przekierowanie oraz
- * wskaźniki na synów danego węzła.
- * Numer odczytujemy jako numery kolejnych ojców danego węzła.
+/**
+ * Liczba kolejnych prefiksów, które wątek pobiera do przetworzenia naraz.
  */
-struct PhoneForward {
-    /** 
-     * Napis reprezentujący napis telefonu, na który mamy przekierowanie. 
+#define PARALLEL_CHUNK 1024
+
+/** @brief Fragment wyniku zapytania odwrotnego.
+ * Przechowuje numery zbudowane z kolejnych @ref PARALLEL_CHUNK
+ * znalezionych prefiksów, zapisane przez jeden wątek.
+ */
+typedef struct ReverseChunk {
+    /**
+     * Bufor znaków przechowujący numery fragmentu.
      */
-    char *forwardNumber;
+    char *buffer;
     /**
-     * Tablica wskaźników na dzieci danego węzła. 
+     * Liczba zajętych znaków bufora.
      */
-    PhoneForward *children[BASE];
-};
+    size_t used;
+    /**
+     * Rozmiar bufora znaków.
+     */
+    size_t size;
+    /**
+     * Przesunięcie bufora fragmentu w buforze wyniku.
+     */
+    size_t base;
+} ReverseChunk;
 
-/** @brief To jest struktura przechowująca ciąg numerów telefonów.
- * Struktura przechowująca tablicę wskaźników na napisy,
- * będące numerami telefonów
- * oraz rozmiar tej tablicy.
+/** @brief Zapytanie odwrotne dzielone między wątki.
+ * Znalezione prefiksy numerują się kolejno wzdłuż ścieżki w drzewie
+ * odwrotnych przekierowań i dzielą na fragmenty, które wątki pobierają
+ * po jednym, dopóki jakieś zostały, więc wątki, które skończą wcześniej,
+ * przejmują pracę pozostałych.
  */
-struct PhoneNumbers {
+typedef struct ParallelReverse {
     /**
-     * Tablica wskaźników na napisy, rerezentujące numery
+     * Wskaźnik na strukturę przechowującą przekierowania.
      */
-    char **numbers;
+    PhoneForward const *pf;
     /**
-     * Rozmiar tablicy numerów wskaźników.
+     * Wskaźnik na napis reprezentujący numer.
      */
-    size_t size;
-};
+    char const *num;
+    /**
+     * Długość numeru @p num.
+     */
+    size_t lenNum;
+    /**
+     * Czy zostawić tylko numery, które są przekierowywane na @p num.
+     */
+    bool verify;
+    /**
+     * Węzły drzewa odwrotnych przekierowań na ścieżce numeru @p num;
+     * węzeł o indeksie @p i reprezentuje prefiks długości @p i + 1.
+     */
+    ReverseNode const **path;
+    /**
+     * Numery pierwszych prefiksów kolejnych węzłów ścieżki, zakończone
+     * liczbą wszystkich prefiksów.
+     */
+    size_t *levelStart;
+    /**
+     * Liczby poziomów prefiksów kolejnych węzłów ścieżki, czyli liczby
+     * ich strumieni.
+     */
+    size_t *levels;
+    /**
+     * Liczba znalezionych prefiksów.
+     */
+    size_t count;
+    /**
+     * Numery strumieni w obrębie węzła ścieżki kolejnych prefiksów.
+     */
+    size_t *stream;
+    /**
+     * Przesunięcia numerów w buforach fragmentów lub @ref PHNUM_NONE dla
+     * numerów, które nie są przekierowywane na @p num.
+     */
+    size_t *offsets;
+    /**
+     * Fragmenty wyniku.
+     */
+    ReverseChunk *chunks;
+    /**
+     * Numer pierwszego fragmentu, którego nie pobrał jeszcze żaden wątek.
+     */
+    size_t next;
+    /**
+     * Czy któremuś wątkowi nie udało się alokować pamięci.
+     */
+    bool failed;
+} ParallelReverse;
 
-/** @brief Sprawdza popraność symbolu.
- * Sprawdza, czy podany symbol należy do
- * zadanego w zadaniu systemu liczbowego.
- * Akceptuje więc cyfry od 0 do 9 oraz znaki * i #.
- * @param[in] c – sprawdzany znak.
- * @return Wartość @p true, gdy znak jest cyfrą podanego systemu liczbowego.
- *         Wartość @p false, w przeciwnym przypadku.
+/** @brief Odtwarza stos przodków prefiksu na początku fragmentu.
+ * Przodkami prefiksu @p sources[@p i] w tym samym węźle są zapisane
+ * w węźle prefiksy tego prefiksu. Prefiksy węzła są posortowane, więc
+ * każdego przodka można znaleźć wyszukiwaniem binarnym, skracając kopię
+ * prefiksu o kolejne cyfry.
+ * @param[in] sources – posortowana tablica prefiksów węzła.
+ * @param[in] i – indeks prefiksu.
+ * @param[in,out] ancestors – wskaźnik na tablicę na stos indeksów
+ *                            przodków wraz z samym prefiksem.
+ * @param[in,out] capacity – rozmiar tablicy @p ancestors.
+ * @return Liczba elementów stosu albo 0, gdy nie udało się alokować
+ *         pamięci.
  */
-static bool isSymbol(char c) {
-    return isdigit(c) || c == '*' || c == '#';
-}
+static size_t ancestorsRebuild(PackedNumber * const *sources, size_t i,
+        size_t **ancestors, size_t *capacity) {
+    PackedNumber const *source = sources[i];
+    if (*capacity < source->length + 1) {
+        size_t *stack = realloc(*ancestors,
+                (source->length + 1) * sizeof(size_t));
+        if (stack == NULL) {
+            return 0;
+        }
+        *ancestors = stack;
+        *capacity = source->length + 1;
+    }
+    PackedNumber *prefix = malloc(packedSize(source->length));
+    if (prefix == NULL) {
+        return 0;
+    }
+    memcpy(prefix, source, packedSize(source->length));
 
-/** @brief Zmienia znak typu char na odpowiadającą mu liczbę typu short.
- * Znaki reprezentujące cyfry zmienia na odpowiadającą cyfrę,
- * znak '*' tratkuje jako 10 a znak '#' jako 11.
- * @param[in] c – zmieniany znak.
- * @return Wartość typu short, odpowiednią dla podanego znaku.
- */
-static short charToInt(char c) {
-    if (isdigit(c)) return c - '0';
-    if (c == '*')   return 10;
-    return 11;
+    size_t depth = 0;
+    size_t high = i;
+    (*ancestors)[depth++] = i;
+    for (uint32_t length = source->length; length-- > 1 && high > 0;) {
+        prefix->length = length;
+        size_t low = 0;
+        size_t end = high;
+        while (low < end) {
+            size_t middle = low + (end - low) / 2;
+            if (packedCompare(sources[middle], prefix) < 0) {
+                low = middle + 1;
+            }
+            else {
+                end = middle;
+            }
+        }
+        if (low < high && packedCompare(sources[low], prefix) == 0) {
+            (*ancestors)[depth++] = low;
+            high = low;
+        }
+    }
+    free(prefix);
+    for (size_t a = 0, b = depth - 1; a < b; a++, b--) {
+        size_t swap = (*ancestors)[a];
+        (*ancestors)[a] = (*ancestors)[b];
+        (*ancestors)[b] = swap;
+    }
+    return depth;
 }
 
-/** @brief Zmienia podaną liczbę typu short na odpowiadający jej znak.
- * Odwrotność funkcji @ref charToInt;
- * @param[in] x – zmieniana liczba.
- * @return Wartość typu char, odpowiednią dla podanej liczby.
+/** @brief Podnosi atomowo wartość do co najmniej podanej.
+ * @param[in,out] value – wskaźnik na wartość;
+ * @param[in] bound     – dolne ograniczenie.
  */
-static char intToChar(short x) {
-    if (x >= 0 && x <= 9)   return '0' + x;
-    if (x == 10)    return '*';
-    return '#';
+static void atomicRaise(size_t *value, size_t bound) {
+    size_t current = __atomic_load_n(value, __ATOMIC_RELAXED);
+    while (current < bound && !__atomic_compare_exchange_n(value, &current,
+                bound, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
 }
 
-PhoneForward * phfwdNew(void) {
-    PhoneForward *pf = malloc(sizeof(PhoneForward));
-    if (pf == NULL) {
-        return NULL;
+/** @brief Przetwarza fragment zapytania odwrotnego.
+ * Działa jak pętla funkcji @ref reverseCollect dla prefiksów fragmentu:
+ * wyznacza ich strumienie, sprawdza przekierowania i zapisuje numery
+ * do bufora fragmentu. Stos przodków pierwszego prefiksu odtwarza
+ * funkcją @ref ancestorsRebuild.
+ * @param[in,out] task – wskaźnik na zapytanie;
+ * @param[in] c        – numer fragmentu;
+ * @param[in,out] ancestors – wskaźnik na tablicę na stos przodków;
+ * @param[in,out] capacity  – rozmiar tablicy @p ancestors.
+ * @return Wartość @p true, jeśli fragment został przetworzony.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool reverseChunk(ParallelReverse *task, size_t c,
+        size_t **ancestors, size_t *capacity) {
+    ReverseChunk *chunk = &task->chunks[c];
+    size_t begin = c * PARALLEL_CHUNK;
+    size_t end = task->count - begin < PARALLEL_CHUNK
+        ? task->count : begin + PARALLEL_CHUNK;
+    size_t index = 0;
+    while (task->levelStart[index + 1] <= begin) {
+        index++;
     }
-    for (short i = 0; i < BASE; i++) {
-        pf->children[i] = NULL;
+    size_t depth = 0;
+    if (begin > task->levelStart[index]) {
+        depth = ancestorsRebuild(task->path[index]->sources,
+                begin - task->levelStart[index] - 1, ancestors, capacity);
+        if (depth == 0) {
+            return false;
+        }
     }
-    pf->forwardNumber = NULL;
-    return pf;
-}
+    size_t levels = depth;
 
-void phfwdDelete(PhoneForward *pf) {
-    if (pf != NULL) {
-        for (short i = 0; i < BASE; i++) {
-            phfwdDelete(pf->children[i]);
+    for (size_t g = begin; g < end; g++) {
+        if (task->levelStart[index + 1] <= g) {
+            atomicRaise(&task->levels[index], levels);
+            do {
+                index++;
+            } while (task->levelStart[index + 1] <= g);
+            depth = 0;
+            levels = 0;
         }
-        if (pf->forwardNumber != NULL){
-            free(pf->forwardNumber);
+        PackedNumber * const *sources = task->path[index]->sources;
+        size_t i = g - task->levelStart[index];
+        PackedNumber const *source = sources[i];
+        while (depth > 0
+                && !packedIsPrefix(sources[(*ancestors)[depth - 1]], source)) {
+            depth--;
         }
-        free(pf);
+        if (depth == *capacity) {
+            size_t *stack = realloc(*ancestors,
+                    (2 * depth + 1) * sizeof(size_t));
+            if (stack == NULL) {
+                return false;
+            }
+            *ancestors = stack;
+            *capacity = 2 * depth + 1;
+        }
+        (*ancestors)[depth++] = i;
+        if (depth > levels) {
+            levels = depth;
+        }
+        task->stream[g] = depth - 1;
+
+        char const *suffix = task->num + index + 1;
+        size_t lenSuffix = task->lenNum - index - 1;
+        if (task->verify
+                && !forwardedBy(task->pf->root, source, suffix, lenSuffix)) {
+            task->offsets[g] = PHNUM_NONE;
+            continue;
+        }
+        size_t length = source->length + lenSuffix + 1;
+        if (chunk->size - chunk->used < length) {
+            size_t size = 2 * chunk->size + length;
+            char *buffer = realloc(chunk->buffer, size);
+            if (buffer == NULL) {
+                return false;
+            }
+            chunk->buffer = buffer;
+            chunk->size = size;
+        }
+        task->offsets[g] = chunk->used;
+        char *out = chunk->buffer + chunk->used;
+        memcpy(packedUnpack(source, out), suffix, lenSuffix + 1);
+        chunk->used += length;
     }
+    atomicRaise(&task->levels[index], levels);
+    return true;
 }
 
-
-/** @brief Sprawdza poprawność podanego numeru.
- * Sprawdza poprawność podanego numeru @p num.
- * Sprawdza, czy @p num nie jest NULL-em, nie jest pusty lub nie zawiera znaku,
- * niebędącego cyfrą.
- * @param[in] num – wskaźnik na sprawdzany napis.
- * @return Wartość @p true, jeśli napis jest poprawną liczbą.
- *         Wartość @p false, jeśli napis nie jest poprawną liczbą,
- *         jest pustym napisem lub wskazuje na NULL.
+/** @brief Przetwarza fragmenty zapytania odwrotnego, dopóki jakieś zostały.
+ * @param[in,out] arg – wskaźnik na zapytanie @ref ParallelReverse.
+ * @return Wartość NULL.
  */
-static bool isNumberOk(char const *num) {
-    if (num == NULL)    return false;
-    if (strcmp(num, "") == 0)   return false;
-    size_t i = 0;
-    while (num[i] != '\0') {
-        if (!isSymbol(num[i]))   return false;
-        i++;
+static void * reverseWorker(void *arg) {
+    ParallelReverse *task = arg;
+    size_t chunks = (task->count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    size_t *ancestors = NULL;
+    size_t capacity = 0;
+    size_t c;
+    while ((c = __atomic_fetch_add(&task->next, 1, __ATOMIC_RELAXED))
+            < chunks) {
+        if (!reverseChunk(task, c, &ancestors, &capacity)) {
+            __atomic_store_n(&task->failed, true, __ATOMIC_RELAXED);
+        }
     }
-    return true;
+    free(ancestors);
+    return NULL;
 }
 
-/** @brief Dodaje przekierowanie numeru telefonu.
- * Schodzi odpowiednio w drzewie przekierowań,
- * po czym dodaje odpowiednie węzły, aż do węzła reprezentującego
- * @ p num1, w którym zapisuje @ p num2.
- * @param[in] pf – wskaźnik na obecny węzeł drzewa przekierowań.
- * @param[in] num1 – wskaźnik na numer, będący prefiksem przekierowań.
- * @param[in] num2 – wskaźnik na numer, na który tworzymy przekierowanie.
- * @param[in] i – obecny indeks cyfry w @ p num1. 
- * @return Wartość @p true, jeśli dodawanie przekierowania się powiodło.
- *         Wartość @p false, w przeciwnym przypadku.
+/**
+ * @brief Znajduje numery, które powinny być zawarte w wyniku funkcji
+ *  @ref phfwdReverse lub @ref phfwdGetReverse, przy pomocy wielu wątków.
+ * Działa jak @ref reverseCollect, ale znalezione prefiksy dzieli
+ * na fragmenty przetwarzane przez wątki funkcją @ref reverseWorker.
+ * Każdy wątek zapisuje numery do własnych buforów, a na koniec bufory
+ * są sklejane, puste pozycje usuwane, a strumienie scalane jak zwykle.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num – wskaźnik na napis reprezentujący poprawny numer.
+ * @param[in] lenNum – długość numeru @p num.
+ * @param[in] verify – czy zostawić tylko numery, które są przekierowywane
+ *                     na numer @p num.
+ * @param[in] count – liczba znalezionych prefiksów, dodatnia.
+ * @param[in] threads – liczba wątków, większa od 1.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
  */
-static bool addPhoneForward(PhoneForward *pf,
-        char const *num1, char const *num2, size_t i) {
-    assert(pf != NULL);
-    if (num1[i] == '\0') {
-        if (pf->forwardNumber != NULL) {
-            free(pf->forwardNumber);
+static PhoneNumbers * reverseCollectParallel(PhoneForward const *pf,
+        char const *num, size_t lenNum, bool verify, size_t count,
+        unsigned threads) {
+    size_t chunks = (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    if (threads > chunks) {
+        threads = (unsigned) chunks;
+    }
+    ParallelReverse task = {
+        .pf = pf, .num = num, .lenNum = lenNum, .verify = verify,
+        .count = count, .next = 0, .failed = false
+    };
+    task.path = malloc(lenNum * sizeof(ReverseNode const *));
+    task.levelStart = malloc((lenNum + 1) * sizeof(size_t));
+    task.levels = calloc(lenNum, sizeof(size_t));
+    task.stream = malloc((count + 1) * sizeof(size_t));
+    task.offsets = malloc(count * sizeof(size_t));
+    task.chunks = calloc(chunks, sizeof(ReverseChunk));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    PhoneNumbers *pn = NULL;
+    bool ok = task.path != NULL && task.levelStart != NULL
+            && task.levels != NULL && task.stream != NULL
+            && task.offsets != NULL && task.chunks != NULL
+            && workers != NULL;
+
+    size_t length = 0;
+    ReverseNode const *node = pf->reverseRoot;
+    for (size_t index = 0; ok && index < lenNum; index++) {
+        node = node->children[charToInt(num[index])];
+        if (node == NULL) {
+            break;
         }
-        pf->forwardNumber = malloc((size_t) (strlen(num2) + 1) * sizeof(char));
-        strcpy(pf->forwardNumber, num2);
+        task.path[length++] = node;
     }
-    else {
-        if (pf->children[charToInt(num1[i])] == NULL) {
-            pf->children[charToInt(num1[i])] = phfwdNew();
-            if (pf->children[charToInt(num1[i])] == NULL) return false;
+    if (ok) {
+        task.levelStart[0] = 0;
+        for (size_t index = 0; index < length; index++) {
+            task.levelStart[index + 1] =
+                    task.levelStart[index] + task.path[index]->size;
         }
-        return addPhoneForward(pf->children[charToInt(num1[i])], 
-                num1, num2, i + 1);
+
+        unsigned started = 0;
+        while (started + 1 < threads && pthread_create(&workers[started],
+                    NULL, reverseWorker, &task) == 0) {
+            started++;
+        }
+        reverseWorker(&task);
+        for (unsigned t = 0; t < started; t++) {
+            pthread_join(workers[t], NULL);
+        }
+        ok = !task.failed;
     }
-    return true;
-}
 
-bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
-    if (pf == NULL) {
-        return false;
+    size_t chars = 0;
+    for (size_t c = 0; ok && c < chunks; c++) {
+        task.chunks[c].base = chars;
+        chars += task.chunks[c].used;
     }
-    if (!isNumberOk(num1) || !isNumberOk(num2) || !strcmp(num1, num2)) {
-        return false;
+    pn = ok ? phnumNew(count + 1, chars + lenNum + 1) : NULL;
+    size_t streams = 0;
+    if (pn != NULL) {
+        for (size_t c = 0; c < chunks; c++) {
+            memcpy(pn->buffer + task.chunks[c].base, task.chunks[c].buffer,
+                    task.chunks[c].used);
+        }
+        pn->used = chars;
+        size_t index = 0;
+        for (size_t g = 0; g < count; g++) {
+            while (task.levelStart[index + 1] <= g) {
+                streams += task.levels[index++];
+            }
+            if (task.offsets[g] != PHNUM_NONE) {
+                pn->offsets[pn->size] = task.offsets[g]
+                        + task.chunks[g / PARALLEL_CHUNK].base;
+                task.stream[pn->size++] = streams + task.stream[g];
+            }
+        }
+        while (index < length) {
+            streams += task.levels[index++];
+        }
     }
 
-    bool result = addPhoneForward(pf, num1, num2, 0);
-    if (!result) {
-        phfwdRemove(pf, num1);
+    for (size_t c = 0; task.chunks != NULL && c < chunks; c++) {
+        free(task.chunks[c].buffer);
     }
-    return result;
+    free(task.chunks);
+    free(task.offsets);
+    free(task.levels);
+    free(task.levelStart);
+    free(task.path);
+    free(workers);
+    if (pn == NULL) {
+        free(task.stream);
+        return NULL;
+    }
+    return reverseFinish(pf, num, lenNum, verify, pn, task.stream, streams);
 }
 
-/** @brief Rekurencyjnie usuwa przekierowania.
- * Usuwa przekierowania, których parametr @p num jest prefiksem.
- * @param[in] pf – wskaźnik na obecny węzeł. 
- * @param[in] num – wskaźnik na sprawdzany napis.
- * @param[in] lenght – długość napisu @p num.
- * @param[in] i – obecny indeks cyfry w @ p num.  
+/** @brief Wyznacza wynik zapytania odwrotnego przy pomocy wielu wątków.
+ * Zapytania o niewielkim wyniku i zapytania do obrazu wykonuje w jednym
+ * wątku.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @param[in] threads – największa liczba wątków lub 0.
+ * @param[in] verify – czy zostawić tylko numery, które są przekierowywane
+ *                     na numer @p num.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
  */
-static void phoneForwardRemove(PhoneForward *pf,
-        char const *num, size_t lenght, size_t i) {
-    if (pf != NULL) {
-        if (i == lenght - 1) {
-            phfwdDelete(pf->children[charToInt(num[i])]);
-            pf->children[charToInt(num[i])] = NULL;
-        }
-        else {
-            phoneForwardRemove(pf->children[charToInt(num[i])],
-                    num, lenght, i + 1);
+static PhoneNumbers * reverseParallel(PhoneForward const *pf,
+        char const *num, unsigned threads, bool verify) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    size_t length = numberLength(num);
+    if (length == 0) {
+        return phnumNew(0, 0);
+    }
+    if (pf->snapshot != NULL) {
+        return snapshotReverse(pf->snapshot, num, length, verify);
+    }
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned) online : 1;
+    }
+    readLock(pf);
+    size_t count = 0;
+    ReverseNode const *node = pf->reverseRoot;
+    for (size_t index = 0; index < length; index++) {
+        node = node->children[charToInt(num[index])];
+        if (node == NULL) {
+            break;
         }
+        count += node->size;
     }
+    PhoneNumbers *pnums = threads > 1 && count >= PARALLEL_MIN
+        ? reverseCollectParallel(pf, num, length, verify, count, threads)
+        : reverseCollect(pf, num, length, verify);
+    readUnlock(pf);
+    return pnums;
 }
 
-void phfwdRemove(PhoneForward *pf, char const *num) {
-    if (pf == NULL || num == NULL || !isNumberOk(num)) {
-        return;
-    }
-    size_t lenght = strlen(num);
-    if (lenght == 0) {
-        return;
-    }
-    phoneForwardRemove(pf, num, lenght, 0);
+PhoneNumbers * phfwdReverseParallel(PhoneForward const *pf, char const *num,
+        unsigned threads) {
+    return reverseParallel(pf, num, threads, false);
 }
 
-/** @brief Tworzy nową strukturę PhoneNumbers.
- * Alokuje pamięć na nową strukturę PhoneNumbers oraz
- * pamięć na pierwszą komórkę tablicy wskaźników na napisy.
- * Ustawia parametr @p size na 0.
- * @return wskaźnik na zaalokowaną pamięć.
- */
-static PhoneNumbers * phnumNew(void) {
-    PhoneNumbers *pnums;
-    pnums = malloc(sizeof(PhoneNumbers));
-    pnums->size = 0;
-    pnums->numbers = (char **)malloc(sizeof(char *));
-    pnums->numbers[0] = NULL;
-    return pnums;
+PhoneNumbers * phfwdGetReverseParallel(PhoneForward const *pf,
+        char const *num, unsigned threads) {
+    return reverseParallel(pf, num, threads, true);
 }
 
+/** @brief Kursor po wyniku funkcji @ref phfwdReverse.
+ * Kursor struktury w pamięci trzyma blokadę odczytu od utworzenia aż
+ * do usunięcia, bo wskazuje na prefiksy drzewa odwrotnych przekierowań.
+ */
+struct PhoneForwardCursor {
+    /**
+     * Wskaźnik na strukturę przechowującą przekierowania.
+     */
+    PhoneForward const *pf;
+    /**
+     * Wskaźnik na kursor lub NULL, jeśli napis nie reprezentował numeru.
+     */
+    ReverseCursor *cursor;
+};
 
-/** @brief Przechodzi przez drzewo PhoneForward po podanym numerze.
- * Przechodzi przez drzewo PhoneForward,
- * zapamiętując ostatnie nie będące NULL-em
- * przekierowanie oraz na indeksie @p j indeks, 
- * na którym znaleziono to przekierowanie.
- * @param[in] pf – wskaźnik na obecny węzeł PhoneForward.
- * @param[in] num – wskaźnik na numer, którego przekierowania szukamy.
- * @param[in] pn – wskaźnik na PhoneNumber,
- *                 zapamiętujący ostatnie napotkane przekierowanie.
- * @param[in] j – wskaźnik na indeks ostatniego napotkanego przekierowania.
- * @param[in] i – indeks na obecną cyfrę w numerze @p num.
+/** @brief Wyznacza prefiksy węzłów ścieżki numeru w drzewie odwrotnych
+ *  przekierowań.
+ * Wypełnia tablicę przekazywaną funkcji @ref reverseCursorNew.
+ * @param[in] root    – wskaźnik na korzeń drzewa odwrotnych przekierowań;
+ * @param[in] num     – wskaźnik na napis reprezentujący poprawny numer;
+ * @param[in] lenNum  – długość numeru @p num;
+ * @param[out] levels – tablica @p lenNum ciągów prefiksów.
  */
-static void phoneForwardGet(PhoneForward const *pf, char const *num,
-        char **pn, size_t *j, size_t i) {
-    if (pf->forwardNumber != NULL) {
-        (*pn) = pf->forwardNumber;
-        (*j) = i;
-    }
-    if (num[i] != '\0' && pf->children[charToInt(num[i])] != NULL) {
-        phoneForwardGet(pf->children[charToInt(num[i])], num, pn, j, i + 1);
+static void reversePath(ReverseNode const *root, char const *num,
+        size_t lenNum, SourceList *levels) {
+    ReverseNode const *node = root;
+    for (size_t index = 0; index < lenNum; index++) {
+        if (node != NULL) {
+            node = node->children[charToInt(num[index])];
+        }
+        levels[index].pointers = node == NULL ? NULL : node->sources;
+        levels[index].offsets = NULL;
+        levels[index].strings = NULL;
+        levels[index].size = node == NULL ? 0 : node->size;
     }
 }
 
-PhoneNumbers * phfwdGet(PhoneForward const *pf, char const *num) {
+PhoneForwardCursor * phfwdReverseBegin(PhoneForward const *pf,
+        char const *num) {
     if (pf == NULL) {
         return NULL;
     }
-    PhoneNumbers *pnums = phnumNew(); 
-
-    if (!isNumberOk(num)) {
-        pnums->size = 1;
-        return pnums;
+    PhoneForwardCursor *cursor = malloc(sizeof(PhoneForwardCursor));
+    if (cursor == NULL) {
+        return NULL;
+    }
+    cursor->pf = pf;
+    cursor->cursor = NULL;
+    size_t length = numberLength(num);
+    if (length == 0) {
+        return cursor;
+    }
+    SourceList *levels = malloc(length * sizeof(SourceList));
+    if (levels == NULL) {
+        free(cursor);
+        return NULL;
     }
 
-    char *pn = NULL;
-    size_t j = 0;
-    
-    phoneForwardGet(pf, num, &pn, &j, 0);
-
-    if (pn == NULL) {
-        pnums->numbers[0] = malloc(sizeof(char));
-        pnums->numbers[0][0] = '\0';
+    if (pf->snapshot != NULL) {
+        snapshotReversePath(pf->snapshot, num, length, levels);
+        cursor->cursor = reverseCursorNew(num, length, levels,
+                pf->snapshot->header->maxDepth);
     }
     else {
-        pnums->numbers[0] = malloc((size_t) (strlen(pn) + 1) * sizeof(char));
-        strcpy(pnums->numbers[0], pn);
+        readLock(pf);
+        reversePath(pf->reverseRoot, num, length, levels);
+        cursor->cursor = reverseCursorNew(num, length, levels,
+                pf->maxDepth);
+        if (cursor->cursor == NULL) {
+            readUnlock(pf);
+        }
     }
+    if (cursor->cursor == NULL) {
+        free(cursor);
+        return NULL;
+    }
+    return cursor;
+}
 
-    size_t len = strlen(pnums->numbers[0]);
-    pnums->numbers[0] = realloc(pnums->numbers[0],
-            (size_t) ((len + strlen(num) - j + 1) * sizeof(char)));
-    strncpy(pnums->numbers[0] + len, num + j, strlen(num) - j + 1);
-
-    pnums->size = 1;
-    return pnums;
+char const * phfwdReverseNext(PhoneForwardCursor *cursor) {
+    if (cursor == NULL || cursor->cursor == NULL) {
+        return NULL;
+    }
+    return reverseCursorNext(cursor->cursor);
 }
 
-/**
- * @brief Sprawdza, czy numer jest prefiksem innego podanego numeru.
- * Sprawdza, czy napis zawiera się
- * w początkowym ciągu znaków innego napisu.
- * @param[in] prefix – napis, dla którego sprawdzamy, czy jest prefiksem.
- * @param[in] num – napis, dla którego sprawdzamy,
- *                  czy drugi napis jest jego prefiksem.
- * @return Wartość @p true, gdy napis jest prefiksem drugiego napisu.
- *         Wartość @p false, w przeciwnym przypadku.
- */
-static bool isPrefixOf(char *prefix, char const *num) {
-    size_t len = strlen(prefix);
-    if (len > strlen(num)) {
-        return false;
+void phfwdReverseEnd(PhoneForwardCursor *cursor) {
+    if (cursor == NULL) {
+        return;
     }
-    for (size_t i = 0; i < len; i++) {
-        if (prefix[i] != num[i]) {
-            return false;
+    if (cursor->cursor != NULL) {
+        reverseCursorDelete(cursor->cursor);
+        if (cursor->pf->snapshot == NULL) {
+            readUnlock(cursor->pf);
         }
     }
-    return true;
+    free(cursor);
 }
 
-/**
- * @brief Zwraca większy rozmiar tablic.
- * Zwraca 2 * @p size + 1,
- * jeśli nie przekroczy to maksymalnego rozmiaru size_t
- * lub maksymalny rozmiar size_t w przeciwnym przypadku.
- * @param[in] size – rozmiar, który chcemy odpowienio powiększyć.
- * @return Nowy, powiększony rozmiar.
- */
-static size_t newSize(size_t size) {
-    if (size > SIZE_MAX / 2 - 1) return SIZE_MAX;
-    return size * 2 + 1;
+bool phfwdStats(PhoneForward const *pf, PhoneForwardStats *stats) {
+    if (pf == NULL || stats == NULL) {
+        return false;
+    }
+    if (pf->snapshot != NULL) {
+        snapshotStats(pf->snapshot, stats);
+        stats->residentBytes += sizeof(PhoneForward) + sizeof(Snapshot);
+        return true;
+    }
+    phfwdReclaimerFlush(pf);
+    readLock(pf);
+    stats->nodes = 0;
+    for (unsigned k = 0; k <= BASE; k++) {
+        stats->fanout[k] = liveNodes(pf, k);
+        stats->nodes += stats->fanout[k];
+    }
+    stats->forwards = pf->forwards;
+    stats->forwardBytes = pf->forwardDigits + pf->forwards;
+    stats->poolBytes = pf->pool.bytes;
+    stats->maxDepth = pf->maxDepth;
+    stats->residentBytes = sizeof(PhoneForward) + arenaBytes(&pf->arena)
+            + poolBytes(&pf->pool)
+            + pf->reverseNodes * sizeof(ReverseNode)
+            + pf->forwards * (sizeof(PackedNumber *) + sizeof(PackedNumber))
+            + (pf->sourceDigits + pf->forwards) / 2
+            + pf->stack.capacity * sizeof(Frame)
+            + pf->depthsSize * sizeof(size_t);
+    if (pf->concurrency != NULL) {
+        stats->residentBytes += sizeof(Concurrency)
+                + pf->concurrency->retiredCapacity * sizeof(Retired);
+    }
+    readUnlock(pf);
+    return true;
 }
 
-/**
- * @brief Zwraca mniejszą z dwóch liczb.
- * @param[in] a – podana liczba.
- * @param[in] b – druga podana liczba.
- * @return Mniejsza z podanych liczb.
+/** @brief Dopisuje spakowany numer do tablicy napisów obrazu.
+ * Napisy wyrównywane są do 4 bajtów, tak jak pole długości numeru.
+ * @param[in,out] strings – wskaźnik na tablicę napisów;
+ * @param[in,out] used    – liczba zajętych bajtów tablicy napisów;
+ * @param[in] number      – wskaźnik na dopisywany numer.
+ * @return Przesunięcie numeru w tablicy napisów.
  */
-static size_t min(size_t a, size_t b) {
-    if (a <= b) return a;
-    else    return b;
+static uint32_t imageString(uint8_t *strings, size_t *used,
+        PackedNumber const *number) {
+    uint32_t offset = (uint32_t) *used;
+    size_t size = packedSize(number->length);
+    memcpy(strings + offset, number, size);
+    *used += (size + 3) & ~(size_t) 3;
+    return offset;
 }
 
-/**
- * @brief Zwraca mniejszy z dwóch napisów w porządku leksykograficznym.
- * @param[in] a – podany napis.
- * @param[in] b – drugi podany napis.
- * @return -1 jeśli napis a jest w porządku leksykograficznym przed b.
- *          0 jeśli napisy są sobie równe.
- *          1 jeśli napis b jest w porządku leksykograficznym przed a.
+/** @brief Tworzy obraz przekierowań.
+ * Przechodzi wszerz drzewo przekierowań i drzewo odwrotnych przekierowań,
+ * więc synowie każdego węzła trafiają do tablicy węzłów obrazu obok
+ * siebie, w kolejności cyfr. Numery, na które wykonywane są
+ * przekierowania, zapisywane są raz, tak jak w puli.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania,
+ *                 niewczytaną z obrazu.
+ * @return Wskaźnik na blok z obrazem, którego rozmiar zapisany jest
+ *         w nagłówku, lub NULL, gdy nie udało się alokować pamięci albo
+ *         przekierowań jest zbyt wiele dla formatu obrazu.
  */
-static int comparator(const void *a, const void *b) {
-    char *num1 = *(char * const *) a;
-    char *num2 = *(char * const *) b;
-
-    size_t len1 = strlen(num1);
-    size_t len2 = strlen(num2);
-
-    for (size_t i = 0; i < min(len1, len2); i++) {
-        if (charToInt(num1[i]) > charToInt(num2[i]))    return 1;
-        if (charToInt(num1[i]) < charToInt(num2[i]))    return -1;
+static SnapshotHeader * imageBuild(PhoneForward const *pf) {
+    size_t nodeCount = 0;
+    for (unsigned k = 0; k <= BASE; k++) {
+        nodeCount += liveNodes(pf, k);
+    }
+    size_t stringsBound = pf->pool.bytes + 3 * (size_t) pf->pool.count
+            + pf->forwards * (sizeof(PackedNumber) + 3)
+            + (pf->sourceDigits + pf->forwards) / 2;
+    if (nodeCount >= UINT32_MAX || pf->reverseNodes >= UINT32_MAX
+            || stringsBound >= UINT32_MAX) {
+        return NULL;
     }
 
-    if (len1 < len2)   return -1;
-    if (len1 > len2)    return 1;
-    return 0;
-}
+    size_t nodesAt = snapshotAlign(sizeof(SnapshotHeader));
+    size_t reverseAt = nodesAt
+            + snapshotAlign(nodeCount * sizeof(SnapshotNode));
+    size_t sourcesAt = reverseAt
+            + snapshotAlign(pf->reverseNodes * sizeof(SnapshotReverseNode));
+    size_t stringsAt = sourcesAt
+            + snapshotAlign(pf->forwards * sizeof(uint32_t));
+    uint8_t *image = calloc(stringsAt + stringsBound, 1);
+    Node const **queue = malloc(nodeCount * sizeof(Node *));
+    ReverseNode const **reverseQueue =
+            malloc(pf->reverseNodes * sizeof(ReverseNode *));
+    uint32_t *targets = malloc(((size_t) pf->pool.size + 1)
+            * sizeof(uint32_t));
+    if (image == NULL || queue == NULL || reverseQueue == NULL
+            || targets == NULL) {
+        free(image);
+        free(queue);
+        free(reverseQueue);
+        free(targets);
+        return NULL;
+    }
 
-/**
- * @brief Znajduje numery,
- *  które powinny być zawarte w wyniku funkcji @ref phfwdReverse.
- * Przechodzi po drzewie @p pf znając ciąg ojców obecnego węzła,
- * sprawdza, czy obecne przekierowanie pozwala na dodanie
- * odpowiedniego numeru do struktury @p pn.
- * @param[in] pf – Wskaźnik na strukturę PhoneForward,
- *                 dla której wykonywana jest funkcja phfwdReverse.
- * @param[in] reverseNum – Wskaźnik na napis reprezentujący numer,
- *                         dla którego wykonywana jest funckja
- *                         @ref phfwdReverse.
- * @param[in, out] currentNum – Wskaźnik na wskaźnik na napis
- *                              reprezentujący numer, 
- *                              którego przekierowanie obecnie sprawdzamy.
- * @param[in] index – Liczba reprezentująca głębokość obecnego węzła.
- * @param[in] currentNumSize – Wskaźnik na napis
- *                             reprezentujący obecny rozmiar tablicy 
- *                             @p pn->Numbers.
- * @param[in, out] pn – Wskaźnik na strukturę PhoneNumbers,
- *                      do której dodajemy znalezione numery.
- * @param[in, out] j – Wskaźnik na liczbę
- *                     reprezentującą obecną ilość numerów w @p pn.
- */
-static void reverse(PhoneForward const *pf, char const *reverseNum,
-        char **currentNum, size_t index, size_t (*currentNumSize),
-        PhoneNumbers *pn, size_t *j) {
-    if (pf != NULL) {
-        if (pf->forwardNumber != NULL 
-                && isPrefixOf(pf->forwardNumber, reverseNum)) {
+    SnapshotNode *nodes = (SnapshotNode *) (image + nodesAt);
+    SnapshotReverseNode *reverseNodes =
+            (SnapshotReverseNode *) (image + reverseAt);
+    uint32_t *sources = (uint32_t *) (image + sourcesAt);
+    uint8_t *strings = image + stringsAt;
+    size_t used = 0;
 
-            if ((*j) == pn->size) {
-                pn->size = newSize(pn->size);
-                pn->numbers = realloc(pn->numbers, pn->size * sizeof(char *));
+    for (size_t h = 0; h <= pf->pool.size; h++) {
+        targets[h] = SNAPSHOT_NONE;
+    }
+    bool ok = true;
+    size_t tail = 0;
+    queue[tail++] = pf->root;
+    for (size_t q = 0; ok && q < tail; q++) {
+        Node const *node = queue[q];
+        SnapshotNode *out = &nodes[q];
+        out->forward = SNAPSHOT_NONE;
+        if (node->forwardNumber != POOL_NONE) {
+            uint32_t *target = &targets[node->forwardNumber];
+            if (*target == SNAPSHOT_NONE) {
+                *target = imageString(strings, &used,
+                        poolGet(&pf->pool, node->forwardNumber));
             }
-            
-            size_t lenReverseNum = strlen(reverseNum);
-            size_t lenForwardNumber = strlen(pf->forwardNumber);
-            pn->numbers[(*j)] = malloc((
-                        index + lenReverseNum - lenForwardNumber + 1)
-                        * sizeof(char));
-            strncpy(pn->numbers[(*j)], (*currentNum), index);
-            strncpy(pn->numbers[(*j)] + index,
-                    reverseNum + lenForwardNumber,
-                    lenReverseNum - lenForwardNumber + 1);
-            (*j)++;
-        }
-        
-        for (short i = 0; i < BASE; i++) {
-            if (index == (*currentNumSize)) {
-                (*currentNumSize) = newSize((*currentNumSize));
-                (*currentNum) = realloc((*currentNum),
-                        (*currentNumSize) * sizeof(char));
+            out->forward = *target;
+        }
+        out->firstChild = (uint32_t) tail;
+        out->childrenMask = node->childrenMask;
+        out->runLength = node->runLength;
+        for (uint8_t k = 0; k < node->runLength; k++) {
+            out->run[k / 2] |= (uint8_t) (node->run[k] << (k % 2 ? 0 : 4));
+        }
+        unsigned count = nodeChildrenCount(node);
+        ok = tail + count <= nodeCount;
+        for (unsigned i = 0; ok && i < count; i++) {
+            queue[tail++] = node->children[i];
+        }
+    }
+    size_t nodesWritten = tail;
+
+    size_t sourceCount = 0;
+    tail = 0;
+    reverseQueue[tail++] = pf->reverseRoot;
+    for (size_t q = 0; ok && q < tail; q++) {
+        ReverseNode const *node = reverseQueue[q];
+        SnapshotReverseNode *out = &reverseNodes[q];
+        out->firstChild = (uint32_t) tail;
+        out->firstSource = (uint32_t) sourceCount;
+        out->sourceCount = (uint32_t) node->size;
+        ok = sourceCount + node->size <= pf->forwards;
+        for (size_t i = 0; ok && i < node->size; i++) {
+            sources[sourceCount++] =
+                    imageString(strings, &used, node->sources[i]);
+        }
+        for (short d = 0; ok && d < BASE; d++) {
+            if (node->children[d] != NULL) {
+                out->childrenMask |= (uint16_t) (1u << d);
+                ok = tail < pf->reverseNodes;
+                if (ok) reverseQueue[tail++] = node->children[d];
             }
-            (*currentNum)[index] = intToChar(i);
-            reverse(pf->children[i], reverseNum, currentNum,
-                    index + 1, currentNumSize, pn, j);
         }
     }
-}
 
-PhoneNumbers * phfwdReverse(PhoneForward const *pf,  char const *num) {
-    if (pf == NULL) {
+    free(queue);
+    free(reverseQueue);
+    free(targets);
+    if (!ok) {
+        free(image);
         return NULL;
     }
-    PhoneNumbers *pn = phnumNew();
-    if (!isNumberOk(num)) {
-        pn->size = 1;
-        return pn;
-    }
-
-    char *currentNum = NULL;
-    size_t currentNumSize = 0;
-    size_t j = 0;
-    reverse(pf, num, &currentNum, 0, &currentNumSize, pn, &j);
-    free(currentNum);
-    
-    pn->numbers = realloc(pn->numbers, (j + 1) * sizeof(char *));
-    pn->size = j + 1;
-    pn->numbers[j] = malloc((strlen(num) + 1) * sizeof(char));
-    strcpy(pn->numbers[j], num);
 
-    qsort((void *) pn->numbers, pn->size, sizeof(char *), comparator);
-
-    PhoneNumbers *pnReturn = phnumNew();
-    pnReturn->numbers = realloc(pnReturn->numbers, pn->size * sizeof(char *));
-    size_t k = 0;
-    for (size_t i = 0; i < pn->size - 1; i++) {
-        if (strcmp(pn->numbers[i], pn->numbers[i + 1]) != 0) {
-            pnReturn->numbers[k] = malloc((
-                        strlen(pn->numbers[i]) + 1) * sizeof(char));
-            strcpy(pnReturn->numbers[k], pn->numbers[i]);
-            k++;
-        }
+    SnapshotHeader *header = (SnapshotHeader *) image;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof header->magic);
+    header->byteOrder = SNAPSHOT_BYTE_ORDER;
+    header->version = SNAPSHOT_VERSION;
+    header->size = stringsAt + used;
+    header->nodes = nodesAt;
+    header->nodeCount = nodesWritten;
+    header->reverseNodes = reverseAt;
+    header->reverseNodeCount = tail;
+    header->sources = sourcesAt;
+    header->sourceCount = sourceCount;
+    header->strings = stringsAt;
+    header->stringsSize = used;
+    header->forwardDigits = pf->forwardDigits;
+    header->poolBytes = pf->pool.bytes;
+    header->maxDepth = pf->maxDepth;
+    for (unsigned k = 0; k <= BASE; k++) {
+        header->fanout[k] = liveNodes(pf, k);
     }
-
-    pnReturn->numbers = realloc(pnReturn->numbers, (k + 1) * sizeof(char *));
-    pnReturn->numbers[k] = malloc((
-                strlen(pn->numbers[pn->size - 1]) + 1) * sizeof(char));
-    strcpy(pnReturn->numbers[k], pn->numbers[pn->size - 1]);
-    pnReturn->size = k + 1;
-
-    phnumDelete(pn);
-    return pnReturn;
+    return header;
 }
 
-PhoneNumbers * phfwdGetReverse(PhoneForward const *pf, char const *num) {
-    if (pf == NULL) {
-        return NULL;
+bool phfwdSave(PhoneForward const *pf, char const *path) {
+    if (pf == NULL || path == NULL) {
+        return false;
     }
-    PhoneNumbers *pnReturn = phnumNew();
-    if (!isNumberOk(num)) {
-        pnReturn->size = 1;
-        return pnReturn;
+    if (pf->snapshot != NULL) {
+        return snapshotWrite(pf->snapshot, path);
     }
-    PhoneNumbers *pn = phfwdReverse(pf, num);
-    size_t k = 0;
-    for (size_t i = 0; i < pn->size; i++) {
-        PhoneNumbers * testPn = phfwdGet(pf, pn->numbers[i]);
-        if (testPn != NULL && testPn->size != 0
-                && !strcmp(testPn->numbers[0], num)) {
-            if (k == pnReturn->size) {
-                pnReturn->size = newSize(pnReturn->size);
-                pnReturn->numbers = realloc(pnReturn->numbers,
-                        pnReturn->size * sizeof(char *));
-            }
-            pnReturn->numbers[k] = malloc(
-                    (strlen(pn->numbers[i]) + 1) * sizeof(char));
-            strcpy(pnReturn->numbers[k], pn->numbers[i]);
-            k++;
-        }
-       phnumDelete(testPn); 
+    phfwdReclaimerFlush(pf);
+    readLock(pf);
+    SnapshotHeader *image = imageBuild(pf);
+    readUnlock(pf);
+    if (image == NULL) {
+        return false;
     }
-
-    pnReturn->size = k;
-    pnReturn->numbers = realloc(pnReturn->numbers, k * sizeof(char *));
-    phnumDelete(pn);
-    return pnReturn;
+    Snapshot snapshot;
+    bool ok = snapshotOpen(&snapshot, image, image->size)
+            && snapshotWrite(&snapshot, path);
+    free(image);
+    return ok;
 }
 
-void phnumDelete(PhoneNumbers *pnum) {
-    if (pnum != NULL) {
-        for(size_t i = 0; i < pnum->size; i++) {
-            free(pnum->numbers[i]);
-        }
-
-        free(pnum->numbers);
-        free(pnum);
+PhoneForward * phfwdLoad(char const *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+    PhoneForward *pf = phoneForwardAlloc();
+    Snapshot *snapshot = malloc(sizeof(Snapshot));
+    if (pf == NULL || snapshot == NULL || !snapshotMap(snapshot, path)) {
+        free(snapshot);
+        phfwdDelete(pf);
+        return NULL;
     }
+    pf->snapshot = snapshot;
+    return pf;
 }
 
-char const * phnumGet(PhoneNumbers const *pnum, size_t idx) {
-    if (pnum == NULL) {
+PhoneForward * phfwdFreeze(PhoneForward const *pf) {
+    if (pf == NULL) {
+        return NULL;
+    }
+    SnapshotHeader *image;
+    if (pf->snapshot != NULL) {
+        image = malloc(pf->snapshot->header->size);
+        if (image != NULL) {
+            memcpy(image, pf->snapshot->header, pf->snapshot->header->size);
+        }
+    }
+    else {
+        phfwdReclaimerFlush(pf);
+        readLock(pf);
+        image = imageBuild(pf);
+        readUnlock(pf);
+    }
+    PhoneForward *frozen = phoneForwardAlloc();
+    Snapshot *snapshot = malloc(sizeof(Snapshot));
+    if (image == NULL || frozen == NULL || snapshot == NULL
+            || !snapshotOpen(snapshot, image, image->size)) {
+        free(image);
+        free(snapshot);
+        phfwdDelete(frozen);
         return NULL;
     }
-    if (idx >= pnum->size)  return NULL;
-    return pnum->numbers[idx];
+    frozen->snapshot = snapshot;
+    return frozen;
 }
-
@@ -27,6 +27,13 @@ typedef struct PhoneForward PhoneForward;
 struct PhoneNumbers;
 typedef struct PhoneNumbers PhoneNumbers;
 
+/**
+ * @typedef PhoneForwardCursor
+ * @brief To jest kursor po wyniku funkcji @ref phfwdReverse.
+ */
+struct PhoneForwardCursor;
+typedef struct PhoneForwardCursor PhoneForwardCursor;
+
 /** @brief Tworzy nową strukturę.
  * Tworzy nową strukturę niezawierającą żadnych przekierowań.
  * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
@@ -34,6 +41,24 @@ typedef struct PhoneNumbers PhoneNumbers;
  */
 PhoneForward * phfwdNew(void);
 
+/** @brief Tworzy nową strukturę do użycia przez wiele wątków.
+ * Tworzy pustą strukturę, tak jak @ref phfwdNew, której funkcje
+ * @ref phfwdGet, @ref phfwdGetInto i @ref phfwdGetBatch można wywoływać
+ * z wielu wątków jednocześnie, także w trakcie zmian struktury, i nigdy
+ * się one nie blokują. Funkcje zmieniające strukturę, czyli
+ * @ref phfwdAdd, @ref phfwdRemove i @ref phfwdImport, wykonują się
+ * po kolei, a zamiast zmieniać węzły czytane przez inne wątki, podmieniają
+ * je na zmienione kopie. Usunięte węzły i numery zwalniane są dopiero
+ * wtedy, gdy żaden czytający wątek nie może już ich używać.
+ * Funkcje @ref phfwdReverse, @ref phfwdGetReverse, @ref phfwdStats
+ * i @ref phfwdSave czekają na zakończenie trwającej zmiany struktury,
+ * podobnie jak @ref phfwdReverseBegin.
+ * Funkcji @ref phfwdDelete nie wolno wywoływać współbieżnie z innymi.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PhoneForward * phfwdNewConcurrent(void);
+
 /** @brief Usuwa strukturę.
  * Usuwa strukturę wskazywaną przez @p pf. Nic nie robi,
  * jeśli wskaźnik ten ma
@@ -58,22 +83,134 @@ void phfwdDelete(PhoneForward *pf);
  *                     na które jest wykonywane przekierowanie.
  * @return Wartość @p true, jeśli przekierowanie zostało dodane.
  *         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
- *         reprezentuje numeru, oba podane numery są identyczne
- *         lub nie udało się alokować pamięci.
+ *         reprezentuje numeru, oba podane numery są identyczne,
+ *         struktura została wczytana funkcją @ref phfwdLoad
+ *         lub utworzona funkcją @ref phfwdFreeze, lub nie udało się
+ *         alokować pamięci.
  */
 bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2);
 
+/** @brief Tworzy strukturę z posortowanych przekierowań.
+ * Tworzy strukturę zawierającą przekierowania prefiksów @p sources[i]
+ * na numery @p targets[i], tak jak kolejne wywołania @ref phfwdAdd,
+ * ale w jednym przejściu, w czasie proporcjonalnym do łącznej długości
+ * numerów. Prefiksy muszą być posortowane leksykograficznie, w porządku
+ * wyniku funkcji @ref phfwdReverse; przy powtórzonym prefiksie wygrywa
+ * ostatnie przekierowanie. Węzły każdego poddrzewa przydzielane są
+ * kolejno, przed swoim ojcem.
+ * @param[in] sources – tablica wskaźników na napisy reprezentujące
+ *                      prefiksy numerów przekierowywanych;
+ * @param[in] targets – tablica wskaźników na napisy reprezentujące
+ *                      numery, na które wykonywane są przekierowania;
+ * @param[in] count   – liczba przekierowań.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy któryś napis nie
+ *         reprezentuje numeru, prefiks jest równy swojemu numerowi
+ *         docelowemu, prefiksy nie są posortowane lub nie udało się
+ *         alokować pamięci.
+ */
+PhoneForward * phfwdBuild(char const * const *sources,
+                          char const * const *targets, size_t count);
+
 /** @brief Usuwa przekierowania.
  * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
  * parametru @p num1 użytego przy dodawaniu.
  * Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.
+ * lub napis nie reprezentuje numeru, nic nie robi. Nic nie robi też dla
+ * struktury wczytanej funkcją @ref phfwdLoad lub utworzonej funkcją
+ * @ref phfwdFreeze.
  * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
  *                     numerów;
  * @param[in] num    – wskaźnik na napis reprezentujący prefiks numerów.
  */
 void phfwdRemove(PhoneForward *pf, char const *num);
 
+/** @brief Uruchamia wątek zwalniający usunięte przekierowania.
+ * Od tej pory @ref phfwdRemove usuwa przekierowania z drzewa odwrotnych
+ * przekierowań i odłącza poddrzewo usuwanego prefiksu, ale jego węzły
+ * i numery zwalnia w tle osobny wątek, porcjami, między którymi mogą
+ * wykonywać się inne zmiany struktury. Wyniki zapytań nie zależą od tego,
+ * czy poddrzewo zostało już zwolnione. @ref phfwdDelete nie czeka
+ * na zwolnienie odłożonych poddrzew, tylko zwalnia je razem z całą
+ * strukturą. Działa tylko dla struktury utworzonej funkcją
+ * @ref phfwdNewConcurrent; ponowne wywołanie nic nie zmienia.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                     numerów.
+ * @return Wartość @p true, jeśli struktura ma wątek zwalniający.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, nie została
+ *         utworzona funkcją @ref phfwdNewConcurrent lub nie udało się
+ *         utworzyć wątku albo alokować pamięci.
+ */
+bool phfwdReclaimerStart(PhoneForward *pf);
+
+/** @brief Czeka na zwolnienie usuniętych przekierowań.
+ * Wraca, gdy wątek zwalniający zwolni wszystkie poddrzewa odłączone przed
+ * wywołaniem. Nic nie robi, jeśli struktura nie ma wątku zwalniającego.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                 numerów.
+ */
+void phfwdReclaimerFlush(PhoneForward const *pf);
+
+/** @brief Podsumowanie importu przekierowań.
+ */
+typedef struct PhoneForwardImport {
+    /**
+     * Liczba przeczytanych wierszy.
+     */
+    size_t lines;
+    /**
+     * Liczba dodanych przekierowań.
+     */
+    size_t added;
+    /**
+     * Liczba pominiętych, niepoprawnych wierszy.
+     */
+    size_t errors;
+    /**
+     * Numer pierwszego niepoprawnego wiersza, licząc od 1, lub 0.
+     */
+    size_t firstError;
+    /**
+     * Numer ostatniego niepoprawnego wiersza lub 0.
+     */
+    size_t lastError;
+} PhoneForwardImport;
+
+/** @brief Dodaje przekierowania odczytane z deskryptora pliku.
+ * Czyta wiersze postaci <tt>num1 num2</tt>, w których numery oddzielone
+ * są spacjami lub tabulatorami, i dla każdego dodaje przekierowanie
+ * tak jak @ref phfwdAdd. Puste wiersze są pomijane. Wiersze, które nie
+ * składają się z dwóch różnych numerów, są pomijane i zliczane jako
+ * błędy. Plik czytany jest dużymi blokami, numery nie są kopiowane,
+ * a zejście w drzewie zaczyna się od miejsca, w którym numer rozchodzi
+ * się z numerem z poprzedniego wiersza, więc import posortowanych
+ * reguł jest znacznie szybszy od wielokrotnego wywołania @ref phfwdAdd.
+ * @param[in,out] pf  – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] fd      – deskryptor pliku otwartego do odczytu;
+ * @param[out] result – wskaźnik na podsumowanie importu lub NULL.
+ * @return Wartość @p true, jeśli przeczytano cały plik.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, została
+ *         wczytana funkcją @ref phfwdLoad lub utworzona funkcją
+ *         @ref phfwdFreeze, nie udało się czytać z pliku
+ *         lub nie udało się alokować pamięci. Przekierowania dodane przed
+ *         błędem pozostają w strukturze.
+ */
+bool phfwdImport(PhoneForward *pf, int fd, PhoneForwardImport *result);
+
+/** @brief Dodaje przekierowania odczytane z pliku.
+ * Działa jak @ref phfwdImport dla pliku o podanej ścieżce.
+ * @param[in,out] pf  – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] path    – ścieżka do pliku;
+ * @param[out] result – wskaźnik na podsumowanie importu lub NULL.
+ * @return Wartość @p true, jeśli przeczytano cały plik.
+ *         Wartość @p false, jeśli któryś ze wskaźników @p pf, @p path ma
+ *         wartość NULL, nie udało się otworzyć lub czytać pliku
+ *         albo alokować pamięci.
+ */
+bool phfwdImportFile(PhoneForward *pf, char const *path,
+                     PhoneForwardImport *result);
+
 /** @brief Wyznacza przekierowanie numeru.
  * Wyznacza przekierowanie podanego numeru. Szuka najdłuższego pasującego
  * prefiksu. Wynikiem jest ciąg zawierający co najwyżej jeden numer. 
@@ -90,6 +227,43 @@ void phfwdRemove(PhoneForward *pf, char const *num);
  */
 PhoneNumbers * phfwdGet(PhoneForward const *pf, char const *num);
 
+/** @brief Wyznacza przekierowanie numeru do podanego bufora.
+ * Wyznacza to samo, co funkcja @ref phfwdGet, ale nie alokuje pamięci:
+ * wynik zapisywany jest w buforze @p buf jako napis zakończony znakiem
+ * '\0', o ile mieści się w nim razem z tym znakiem. W przeciwnym
+ * przypadku, jeśli @p cap jest dodatnie, w buforze zapisywany jest pusty
+ * napis. Wywołanie z @p cap równym zeru pozwala poznać potrzebny rozmiar.
+ * @param[in] pf   – wskaźnik na strukturę
+ * przechowującą przekierowania numerów;
+ * @param[in] num  – wskaźnik na napis reprezentujący numer;
+ * @param[out] buf – wskaźnik na bufor na wynik lub NULL;
+ * @param[in] cap  – rozmiar bufora @p buf w bajtach.
+ * @return Długość wyniku bez kończącego znaku '\0', czyli o jeden
+ *         mniej niż potrzebny rozmiar bufora. Wartość 0, jeśli @p pf
+ *         ma wartość NULL lub napis @p num nie reprezentuje numeru.
+ */
+size_t phfwdGetInto(PhoneForward const *pf, char const *num,
+                    char *buf, size_t cap);
+
+/** @brief Wyznacza przekierowania wielu numerów.
+ * Dla każdego z @p count numerów z tablicy @p nums wyznacza to samo,
+ * co funkcja @ref phfwdGet, zapisując wszystkie wyniki w jednej strukturze:
+ * numer o indeksie @p i wyniku jest przekierowaniem numeru @p nums[i].
+ * Jeśli napis @p nums[i] nie reprezentuje numeru, to pod indeksem @p i
+ * wyniku jest NULL. Przechodzenie drzewa dla kilku numerów jest
+ * przeplatane, co ukrywa opóźnienia dostępu do pamięci.
+ * Alokuje strukturę @p PhoneNumbers, która musi być zwolniona za pomocą
+ * funkcji @ref phnumDelete.
+ * @param[in] pf    – wskaźnik na strukturę
+ * przechowującą przekierowania numerów;
+ * @param[in] nums  – tablica wskaźników na napisy reprezentujące numery;
+ * @param[in] count – liczba numerów w tablicy @p nums.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL,
+ *         gdy nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdGetBatch(PhoneForward const *pf,
+                             char const * const *nums, size_t count);
+
 /** @brief Wyznacza przekierowania na dany numer.
  * Wyznacza wszystkie numery w @p pf, dla których prefiksu 
  * istnieje takie przekierowanie, że numer ten po przekierowaniu prefiksu
@@ -123,6 +297,177 @@ PhoneNumbers * phfwdReverse(PhoneForward const *pf, char const *num);
  */
 PhoneNumbers * phfwdGetReverse(PhoneForward const *pf, char const *num);
 
+/** @brief Wyznacza przekierowania na dany numer przy pomocy wielu wątków.
+ * Daje ten sam wynik co @ref phfwdReverse. Gdy wynik liczy co najmniej
+ * kilka tysięcy numerów, rozpakowanie i sklejenie numerów rozdziela
+ * pomiędzy co najwyżej @p threads wątków, które pobierają pracę
+ * fragmentami ze wspólnej puli, a na koniec scala ich wyniki. Mniejsze
+ * zapytania i zapytania do struktur wczytanych funkcją @ref phfwdLoad
+ * lub utworzonych funkcją @ref phfwdFreeze wykonuje w wywołującym wątku.
+ * @param[in] pf      – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] num     – wskaźnik na napis reprezentujący numer;
+ * @param[in] threads – największa liczba wątków, razem z wywołującym,
+ *                      lub 0, by użyć tylu wątków, ile jest procesorów.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdReverseParallel(PhoneForward const *pf, char const *num,
+                                    unsigned threads);
+
+/** @brief Wyznacza numery przekierowywane na dany numer przy pomocy wielu
+ *  wątków.
+ * Daje ten sam wynik co @ref phfwdGetReverse, a pracę dzieli tak jak
+ * @ref phfwdReverseParallel. Między wątki rozdzielane jest także
+ * sprawdzanie, czy numer jest przekierowywany na podany numer, które
+ * dominuje koszt dużych zapytań.
+ * @param[in] pf      – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] num     – wskaźnik na napis reprezentujący numer;
+ * @param[in] threads – największa liczba wątków, razem z wywołującym,
+ *                      lub 0, by użyć tylu wątków, ile jest procesorów.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdGetReverseParallel(PhoneForward const *pf,
+                                       char const *num, unsigned threads);
+
+/** @brief Rozpoczyna wyznaczanie przekierowań na dany numer po jednym.
+ * Tworzy kursor, który zwraca numery z wyniku funkcji @ref phfwdReverse
+ * w tej samej kolejności, ale wyznacza każdy dopiero w wywołaniu
+ * @ref phfwdReverseNext. Nie tworzy całego wyniku, więc pierwszy numer
+ * dostępny jest od razu, a pamięć kursora zależy od długości numeru
+ * i najdłuższego przekierowywanego prefiksu, a nie od liczby numerów.
+ * Do wywołania @ref phfwdReverseEnd struktury nie wolno zmieniać.
+ * Kursor struktury utworzonej funkcją @ref phfwdNewConcurrent wstrzymuje
+ * jej zmiany przez inne wątki aż do wywołania @ref phfwdReverseEnd
+ * w wątku, który go utworzył.
+ * @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania
+ *                  numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na kursor, który musi być usunięty funkcją
+ *         @ref phfwdReverseEnd, lub NULL, gdy @p pf ma wartość NULL
+ *         lub nie udało się alokować pamięci. Jeśli podany napis nie
+ *         reprezentuje numeru, kursor nie zwraca żadnego numeru.
+ */
+PhoneForwardCursor * phfwdReverseBegin(PhoneForward const *pf,
+                                       char const *num);
+
+/** @brief Wyznacza kolejny numer kursora.
+ * Nie alokuje pamięci.
+ * @param[in,out] cursor – wskaźnik na kursor lub NULL.
+ * @return Wskaźnik na kolejny numer, ważny do następnego wywołania
+ *         @ref phfwdReverseNext lub @ref phfwdReverseEnd na tym kursorze,
+ *         albo NULL, jeśli kursor zwrócił już wszystkie numery lub
+ *         @p cursor ma wartość NULL.
+ */
+char const * phfwdReverseNext(PhoneForwardCursor *cursor);
+
+/** @brief Usuwa kursor.
+ * Nic nie robi, jeśli @p cursor ma wartość NULL.
+ * @param[in] cursor – wskaźnik na usuwany kursor.
+ */
+void phfwdReverseEnd(PhoneForwardCursor *cursor);
+
+/**
+ * Największa liczba synów węzła drzewa przekierowań.
+ */
+#define PHFWD_MAX_CHILDREN 12
+
+/** @brief Statystyki struktury przechowującej przekierowania.
+ */
+typedef struct PhoneForwardStats {
+    /**
+     * Liczba węzłów drzewa przekierowań.
+     */
+    size_t nodes;
+    /**
+     * Liczba przekierowań.
+     */
+    size_t forwards;
+    /**
+     * Łączny rozmiar w bajtach napisów, na które wykonywane są
+     * przekierowania, razem z kończącymi je znakami '\0'.
+     */
+    size_t forwardBytes;
+    /**
+     * Rzeczywisty rozmiar w bajtach spakowanych, współdzielonych
+     * numerów, na które wykonywane są przekierowania.
+     */
+    size_t poolBytes;
+    /**
+     * Długość najdłuższego przekierowywanego prefiksu, czyli głębokość
+     * drzewa przekierowań liczona w cyfrach.
+     */
+    size_t maxDepth;
+    /**
+     * Liczby węzłów o kolejnych liczbach synów.
+     */
+    size_t fanout[PHFWD_MAX_CHILDREN + 1];
+    /**
+     * Szacowany rozmiar pamięci zajmowanej przez strukturę w bajtach,
+     * bez narzutu funkcji malloc.
+     */
+    size_t residentBytes;
+} PhoneForwardStats;
+
+/** @brief Wyznacza statystyki struktury.
+ * Liczniki są uaktualniane przy dodawaniu i usuwaniu przekierowań,
+ * więc działa w czasie stałym. W strukturze z wątkiem zwalniającym
+ * najpierw czeka, jak @ref phfwdReclaimerFlush, aż zostaną zwolnione
+ * usunięte węzły.
+ * @param[in] pf     – wskaźnik na strukturę
+ * przechowującą przekierowania numerów;
+ * @param[out] stats – wskaźnik na wypełniane statystyki.
+ * @return Wartość @p true, jeśli statystyki zostały wyznaczone.
+ *         Wartość @p false, jeśli któryś ze wskaźników ma wartość NULL.
+ */
+bool phfwdStats(PhoneForward const *pf, PhoneForwardStats *stats);
+
+/** @brief Zapisuje przekierowania do pliku.
+ * Zapisuje obraz przekierowań w formacie niezależnym od adresu, pod którym
+ * zostanie wczytany: węzły odwołują się do synów i napisów przez indeksy
+ * i przesunięcia. Plik można wczytać funkcją @ref phfwdLoad na maszynie
+ * o tym samym porządku bajtów.
+ * @param[in] pf   – wskaźnik na strukturę
+ * przechowującą przekierowania numerów;
+ * @param[in] path – ścieżka do pliku.
+ * @return Wartość @p true, jeśli przekierowania zostały zapisane.
+ *         Wartość @p false, jeśli któryś ze wskaźników ma wartość NULL,
+ *         nie udało się alokować pamięci lub zapisać pliku.
+ */
+bool phfwdSave(PhoneForward const *pf, char const *path);
+
+/** @brief Wczytuje przekierowania z pliku.
+ * Odwzorowuje plik zapisany funkcją @ref phfwdSave w pamięci tylko do
+ * odczytu, bez deserializacji, więc wczytanie nie zależy od liczby
+ * przekierowań. Wynikową strukturę można odpytywać funkcjami
+ * @ref phfwdGet, @ref phfwdReverse i pokrewnymi, ale nie można jej
+ * modyfikować: @ref phfwdAdd zwraca wartość @p false, a @ref phfwdRemove
+ * nic nie robi. Strukturę usuwa się funkcją @ref phfwdDelete.
+ * @param[in] path – ścieżka do pliku.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy @p path ma wartość
+ *         NULL, nie udało się odczytać pliku, nie zawiera on poprawnego
+ *         obrazu lub nie udało się alokować pamięci.
+ */
+PhoneForward * phfwdLoad(char const *path);
+
+/** @brief Zamraża przekierowania.
+ * Tworzy niezmienną kopię struktury w postaci obrazu takiego jak zapisywany
+ * funkcją @ref phfwdSave, ale w pamięci, bez pliku. Węzły leżą w jednej
+ * tablicy w kolejności przechodzenia wszerz, synowie każdego węzła obok
+ * siebie, a numery we wspólnej tablicy napisów, więc wyszukiwanie
+ * odwołuje się do znacznie mniejszej liczby linii pamięci podręcznej niż
+ * w strukturze ze wskaźnikami. Wynikową strukturę odpytuje się i usuwa
+ * tak jak wczytaną funkcją @ref phfwdLoad; jako niezmienną można ją
+ * odpytywać z wielu wątków jednocześnie bez blokad.
+ * @param[in] pf – wskaźnik na zamrażaną strukturę.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy @p pf ma wartość
+ *         NULL, przekierowań jest zbyt wiele dla formatu obrazu lub nie
+ *         udało się alokować pamięci.
+ */
+PhoneForward * phfwdFreeze(PhoneForward const *pf);
+
 /** @brief Usuwa strukturę.
  * Usuwa strukturę wskazywaną przez @p pnum. Nic nie robi,
  * jeśli wskaźnik ten ma wartość NULL.
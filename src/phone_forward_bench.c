@@ -0,0 +1,506 @@
+/** @file
+ * Pomiar wydajności operacji na przekierowaniach numerów telefonów
+ *
+ * Buduje powtarzalne, syntetyczne obciążenia i dla każdej operacji
+ * wypisuje liczbę operacji na sekundę, medianę i 99. percentyl czasu
+ * jednej operacji, a na końcu szczytowe zużycie pamięci procesu.
+ * Wywołanie: phone_forward_bench [liczba przekierowań] [ziarno].
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "phone_forward.h"
+#include "phone_forward_shards.h"
+#include "number_sort.h"
+
+/**
+ * Domyślna liczba przekierowań.
+ */
+#define DEFAULT_FORWARDS 200000
+
+/**
+ * Maksymalna długość generowanego numeru.
+ */
+#define MAX_LEN 24
+
+/**
+ * Liczba numerów kierunkowych, od których zaczynają się numery.
+ */
+#define AREAS 64
+
+/**
+ * Liczba zapytań przekazywanych naraz do @ref phfwdGetBatch.
+ */
+#define BATCH 256
+
+/**
+ * Liczba wątków dodających przekierowania do struktury podzielonej
+ * na części.
+ */
+#define WRITERS 4
+
+/**
+ * Stan generatora liczb pseudolosowych.
+ */
+static uint64_t state;
+
+/** @brief Losuje liczbę.
+ * Generator xorshift64*, dający te same ciągi na każdej platformie.
+ * @return Pseudolosowa liczba 64-bitowa.
+ */
+static uint64_t nextRandom(void) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+/** @brief Losuje liczbę z przedziału.
+ * @param[in] bound – górne ograniczenie, większe od zera.
+ * @return Pseudolosowa liczba z przedziału [0, @p bound).
+ */
+static size_t randomBelow(size_t bound) {
+    return (size_t) (nextRandom() % bound);
+}
+
+/** @brief Losuje indeks o rozkładzie skośnym.
+ * Małe indeksy są wybierane znacznie częściej niż duże, co odpowiada
+ * kilku popularnym numerom docelowym i wielu rzadko używanym.
+ * @param[in] bound – liczba indeksów, większa od zera.
+ * @return Pseudolosowy indeks z przedziału [0, @p bound).
+ */
+static size_t randomSkewed(size_t bound) {
+    double u = (double) (nextRandom() >> 11) / (double) (1ULL << 53);
+    return (size_t) (u * u * u * (double) bound);
+}
+
+/** @brief Dopisuje losowe cyfry do napisu.
+ * @param[in,out] num – napis, do którego dopisujemy cyfry.
+ * @param[in] count – liczba dopisywanych cyfr.
+ */
+static void appendDigits(char *num, size_t count) {
+    size_t length = strlen(num);
+    for (size_t i = 0; i < count; i++) {
+        num[length + i] = (char) ('0' + randomBelow(10));
+    }
+    num[length + count] = '\0';
+}
+
+/** @brief Zbiór syntetycznych numerów.
+ * Numery przechowywane są w jednej tablicy, każdy w polu
+ * o stałej długości.
+ */
+typedef struct Numbers {
+    /**
+     * Tablica numerów.
+     */
+    char (*items)[MAX_LEN + 1];
+    /**
+     * Liczba numerów.
+     */
+    size_t count;
+} Numbers;
+
+/** @brief Tworzy zbiór numerów o realistycznych prefiksach.
+ * Każdy numer zaczyna się jednym z @ref AREAS numerów kierunkowych
+ * o długości od 2 do 4 cyfr, wybieranych z rozkładem skośnym, po którym
+ * następuje od @p minDigits do @p maxDigits losowych cyfr.
+ * @param[in] areas – tablica numerów kierunkowych.
+ * @param[in] count – liczba numerów.
+ * @param[in] minDigits – najmniejsza liczba cyfr po numerze kierunkowym.
+ * @param[in] maxDigits – największa liczba cyfr po numerze kierunkowym.
+ * @return Utworzony zbiór numerów.
+ */
+static Numbers numbersNew(char const areas[][MAX_LEN + 1], size_t count,
+        size_t minDigits, size_t maxDigits) {
+    Numbers numbers = {malloc(count * sizeof(*numbers.items)), count};
+    if (numbers.items == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < count; i++) {
+        strcpy(numbers.items[i], areas[randomSkewed(AREAS)]);
+        appendDigits(numbers.items[i],
+                minDigits + randomBelow(maxDigits - minDigits + 1));
+    }
+    return numbers;
+}
+
+/** @brief Zadanie wątku dodającego przekierowania.
+ */
+typedef struct Writer {
+    /**
+     * Wskaźnik na strukturę, do której dodawane są przekierowania.
+     */
+    PhoneForwardShards *shards;
+    /**
+     * Wskaźnik na przekierowywane prefiksy.
+     */
+    Numbers const *sources;
+    /**
+     * Wskaźnik na numery, na które wykonywane są przekierowania.
+     */
+    Numbers const *targets;
+    /**
+     * Numer wątku; wątek dodaje co @ref WRITERS przekierowanie,
+     * zaczynając od tego numeru.
+     */
+    size_t index;
+} Writer;
+
+/** @brief Dodaje przekierowania przydzielone wątkowi.
+ * @param[in] data – wskaźnik na zadanie wątku.
+ * @return NULL.
+ */
+static void * writerRun(void *data) {
+    Writer const *writer = data;
+    for (size_t i = writer->index; i < writer->sources->count; i += WRITERS) {
+        phfwdShardsAdd(writer->shards, writer->sources->items[i],
+                writer->targets->items[i % writer->targets->count]);
+    }
+    return NULL;
+}
+
+/** @brief Wyniki pomiaru jednej operacji.
+ */
+typedef struct Timing {
+    /**
+     * Czasy kolejnych operacji w nanosekundach.
+     */
+    uint64_t *samples;
+    /**
+     * Liczba wykonanych operacji.
+     */
+    size_t count;
+    /**
+     * Łączny czas wszystkich operacji w nanosekundach.
+     */
+    uint64_t total;
+} Timing;
+
+/** @brief Zwraca bieżący czas.
+ * @return Czas zegara monotonicznego w nanosekundach.
+ */
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/** @brief Porównuje czasy operacji.
+ * @param[in] a – wskaźnik na pierwszy czas.
+ * @param[in] b – wskaźnik na drugi czas.
+ * @return Liczba ujemna, zero lub liczba dodatnia, jeśli pierwszy czas
+ *         jest odpowiednio krótszy, równy lub dłuższy od drugiego.
+ */
+static int compareSamples(void const *a, void const *b) {
+    uint64_t x = *(uint64_t const *) a;
+    uint64_t y = *(uint64_t const *) b;
+    return (x > y) - (x < y);
+}
+
+/** @brief Rozpoczyna pomiar operacji.
+ * @param[in] capacity – największa liczba mierzonych operacji.
+ * @return Pusty pomiar.
+ */
+static Timing timingNew(size_t capacity) {
+    Timing timing = {malloc((capacity + 1) * sizeof(uint64_t)), 0, 0};
+    if (timing.samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return timing;
+}
+
+/** @brief Zapisuje czas jednej operacji.
+ * @param[in,out] timing – wskaźnik na pomiar.
+ * @param[in] start – czas rozpoczęcia operacji.
+ */
+static void timingAdd(Timing *timing, uint64_t start) {
+    uint64_t elapsed = now() - start;
+    timing->samples[timing->count++] = elapsed;
+    timing->total += elapsed;
+}
+
+/** @brief Wypisuje wyniki pomiaru i zwalnia go.
+ * @param[in] name – nazwa mierzonej operacji.
+ * @param[in,out] timing – wskaźnik na pomiar.
+ */
+static void timingReport(char const *name, Timing *timing) {
+    if (timing->count == 0) {
+        free(timing->samples);
+        return;
+    }
+    qsort(timing->samples, timing->count, sizeof(uint64_t), compareSamples);
+    uint64_t p50 = timing->samples[timing->count / 2];
+    uint64_t p99 = timing->samples[timing->count * 99 / 100];
+    double seconds = (double) timing->total / 1e9;
+    printf("%-16s %10zu ops %14.0f ops/s   p50 %9llu ns   p99 %9llu ns\n",
+            name, timing->count,
+            seconds > 0 ? (double) timing->count / seconds : 0.0,
+            (unsigned long long) p50, (unsigned long long) p99);
+    free(timing->samples);
+}
+
+/** @brief Uruchamia pomiary.
+ * @param[in] argc – liczba argumentów.
+ * @param[in] argv – argumenty: liczba przekierowań i ziarno generatora.
+ * @return Kod wyjścia programu.
+ */
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_FORWARDS;
+    state = argc > 2 ? strtoull(argv[2], NULL, 10) : 20220101;
+    if (n == 0 || state == 0) {
+        fprintf(stderr, "usage: %s [forwards > 0] [seed > 0]\n", argv[0]);
+        return 1;
+    }
+    printf("forwards %zu, seed %llu\n", n, (unsigned long long) state);
+
+    char areas[AREAS][MAX_LEN + 1];
+    for (size_t i = 0; i < AREAS; i++) {
+        areas[i][0] = '\0';
+        appendDigits(areas[i], 2 + randomBelow(3));
+    }
+    Numbers sources = numbersNew(areas, n, 2, 6);
+    Numbers targets = numbersNew(areas, n / 16 + 1, 3, 7);
+    Numbers queries = numbersNew(areas, n, 7, 9);
+
+    PhoneForward *pf = phfwdNew();
+    if (pf == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    Timing timing = timingNew(n);
+    for (size_t i = 0; i < n; i++) {
+        char const *target = targets.items[randomSkewed(targets.count)];
+        uint64_t start = now();
+        phfwdAdd(pf, sources.items[i], target);
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdAdd", &timing);
+
+    FILE *rules = tmpfile();
+    if (rules == NULL) {
+        fprintf(stderr, "cannot create temporary file\n");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        fprintf(rules, "%s %s\n", sources.items[i],
+                targets.items[i % targets.count]);
+    }
+    fflush(rules);
+    rewind(rules);
+    PhoneForward *imported = phfwdNew();
+    PhoneForwardImport summary;
+    uint64_t importStart = now();
+    if (imported == NULL
+            || !phfwdImport(imported, fileno(rules), &summary)) {
+        fprintf(stderr, "import failed\n");
+        return 1;
+    }
+    double importSeconds = (double) (now() - importStart) / 1e9;
+    printf("%-16s %10zu ops %14.0f ops/s\n", "phfwdImport", summary.added,
+            importSeconds > 0 ? (double) summary.added / importSeconds : 0.0);
+    phfwdDelete(imported);
+    fclose(rules);
+
+    char const **sorted = malloc(2 * n * sizeof(char const *));
+    if (sorted == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        sorted[i] = sources.items[i];
+        sorted[n + i] = targets.items[i % targets.count];
+    }
+    if (!numberSort(sorted, n)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint64_t buildStart = now();
+    PhoneForward *built = phfwdBuild(sorted, sorted + n, n);
+    double buildSeconds = (double) (now() - buildStart) / 1e9;
+    if (built == NULL) {
+        fprintf(stderr, "build failed\n");
+        return 1;
+    }
+    printf("%-16s %10zu ops %14.0f ops/s\n", "phfwdBuild", n,
+            buildSeconds > 0 ? (double) n / buildSeconds : 0.0);
+    phfwdDelete(built);
+    free(sorted);
+
+    PhoneForwardShards *shards = phfwdShardsNew();
+    if (shards == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    Writer writers[WRITERS];
+    pthread_t threads[WRITERS];
+    uint64_t shardsStart = now();
+    for (size_t w = 0; w < WRITERS; w++) {
+        writers[w] = (Writer) {shards, &sources, &targets, w};
+        if (pthread_create(&threads[w], NULL, writerRun, &writers[w]) != 0) {
+            fprintf(stderr, "cannot create thread\n");
+            return 1;
+        }
+    }
+    for (size_t w = 0; w < WRITERS; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    double shardsSeconds = (double) (now() - shardsStart) / 1e9;
+    printf("%-16s %10zu ops %14.0f ops/s\n", "phfwdShardsAdd*4", n,
+            shardsSeconds > 0 ? (double) n / shardsSeconds : 0.0);
+    phfwdShardsDelete(shards);
+
+    timing = timingNew(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t start = now();
+        phnumDelete(phfwdGet(pf, queries.items[i]));
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdGet", &timing);
+
+    PhoneForward *frozen = phfwdFreeze(pf);
+    if (frozen == NULL) {
+        fprintf(stderr, "freeze failed\n");
+        return 1;
+    }
+    timing = timingNew(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t start = now();
+        phnumDelete(phfwdGet(frozen, queries.items[i]));
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdGet frozen", &timing);
+    phfwdDelete(frozen);
+
+    char const *batch[BATCH];
+    timing = timingNew(n / BATCH + 1);
+    for (size_t i = 0; i + BATCH <= n; i += BATCH) {
+        for (size_t q = 0; q < BATCH; q++) {
+            batch[q] = queries.items[i + q];
+        }
+        uint64_t start = now();
+        phnumDelete(phfwdGetBatch(pf, batch, BATCH));
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdGetBatch*256", &timing);
+
+    size_t reverses = n / 10 + 1;
+    Numbers reverseQueries = numbersNew(areas, reverses, 5, 9);
+    for (size_t i = 0; i < reverses; i += 2) {
+        strcpy(reverseQueries.items[i],
+                targets.items[randomSkewed(targets.count)]);
+        appendDigits(reverseQueries.items[i], randomBelow(4));
+    }
+    timing = timingNew(reverses);
+    for (size_t i = 0; i < reverses; i++) {
+        uint64_t start = now();
+        phnumDelete(phfwdReverse(pf, reverseQueries.items[i]));
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdReverse", &timing);
+
+    timing = timingNew(reverses);
+    for (size_t i = 0; i < reverses; i++) {
+        uint64_t start = now();
+        PhoneForwardCursor *cursor =
+                phfwdReverseBegin(pf, reverseQueries.items[i]);
+        phfwdReverseNext(cursor);
+        phfwdReverseEnd(cursor);
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdReverseNext", &timing);
+
+    timing = timingNew(reverses);
+    for (size_t i = 0; i < reverses; i++) {
+        uint64_t start = now();
+        phnumDelete(phfwdGetReverse(pf, reverseQueries.items[i]));
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdGetReverse", &timing);
+
+    Timing mixed[5] = {timingNew(n), timingNew(n), timingNew(n),
+        timingNew(n), timingNew(n)};
+    for (size_t i = 0; i < n; i++) {
+        size_t op = randomBelow(100);
+        uint64_t start = now();
+        if (op < 70) {
+            phnumDelete(phfwdGet(pf, queries.items[randomBelow(n)]));
+            timingAdd(&mixed[0], start);
+        }
+        else if (op < 85) {
+            phfwdAdd(pf, sources.items[randomBelow(n)],
+                    targets.items[randomSkewed(targets.count)]);
+            timingAdd(&mixed[1], start);
+        }
+        else if (op < 92) {
+            phnumDelete(phfwdReverse(pf,
+                        reverseQueries.items[randomBelow(reverses)]));
+            timingAdd(&mixed[2], start);
+        }
+        else if (op < 97) {
+            phnumDelete(phfwdGetReverse(pf,
+                        reverseQueries.items[randomBelow(reverses)]));
+            timingAdd(&mixed[3], start);
+        }
+        else {
+            phfwdRemove(pf, sources.items[randomBelow(n)]);
+            timingAdd(&mixed[4], start);
+        }
+    }
+    timingReport("mixed Get", &mixed[0]);
+    timingReport("mixed Add", &mixed[1]);
+    timingReport("mixed Reverse", &mixed[2]);
+    timingReport("mixed GetReverse", &mixed[3]);
+    timingReport("mixed Remove", &mixed[4]);
+
+    PhoneForwardStats stats;
+    phfwdStats(pf, &stats);
+    printf("nodes %zu, forwards %zu, forward bytes %zu (pooled %zu), "
+            "max depth %zu, estimated %zu KiB\n", stats.nodes,
+            stats.forwards, stats.forwardBytes, stats.poolBytes,
+            stats.maxDepth, stats.residentBytes / 1024);
+    printf("fanout");
+    for (size_t k = 0; k <= PHFWD_MAX_CHILDREN; k++) {
+        printf(" %zu", stats.fanout[k]);
+    }
+    printf("\n");
+
+    timing = timingNew(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t start = now();
+        phfwdRemove(pf, sources.items[i]);
+        timingAdd(&timing, start);
+    }
+    timingReport("phfwdRemove", &timing);
+
+    timing = timingNew(1);
+    uint64_t start = now();
+    phfwdDelete(pf);
+    timingAdd(&timing, start);
+    timingReport("phfwdDelete", &timing);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        printf("peak RSS %ld KiB\n", usage.ru_maxrss);
+    }
+
+    free(sources.items);
+    free(targets.items);
+    free(queries.items);
+    free(reverseQueries.items);
+    return 0;
+}
@@ -3,7 +3,9 @@
 #endif
 
 #include "phone_forward.h"
+#include "phone_forward_shards.h"
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
 #define MAX_LEN 23
@@ -120,6 +122,15 @@ int main() {
   assert(strcmp(phnumGet(pnum, 2), "434") == 0);
   assert(phnumGet(pnum, 3) == NULL);
   phnumDelete(pnum);
+  PhoneForwardCursor *cursor = phfwdReverseBegin(pf, "434");
+  assert(strcmp(phfwdReverseNext(cursor), "2334") == 0);
+  assert(strcmp(phfwdReverseNext(cursor), "234") == 0);
+  assert(strcmp(phfwdReverseNext(cursor), "434") == 0);
+  assert(phfwdReverseNext(cursor) == NULL);
+  phfwdReverseEnd(cursor);
+  cursor = phfwdReverseBegin(pf, "A");
+  assert(cursor != NULL && phfwdReverseNext(cursor) == NULL);
+  phfwdReverseEnd(cursor);
 
   phfwdDelete(pf);
   pnum = NULL;
@@ -139,5 +150,185 @@ int main() {
   assert(strcmp(phnumGet(pnum, 0), "7581") == 0);
   assert(phnumGet(pnum, 1) == NULL);
   phnumDelete(pnum);
+
+  char buf[MAX_LEN + 1];
+  assert(phfwdGetInto(pf, "1234581", buf, sizeof buf) == 5);
+  assert(strcmp(buf, "76581") == 0);
+  assert(phfwdGetInto(pf, "1234581", buf, 5) == 5);
+  assert(strcmp(buf, "") == 0);
+  assert(phfwdGetInto(pf, "7581", NULL, 0) == 4);
+  assert(phfwdGetInto(pf, "A", buf, sizeof buf) == 0);
+
+  char const *batch[] = {"1234581", "A", "7581", "1234"};
+  pnum = phfwdGetBatch(pf, batch, 4);
+  assert(strcmp(phnumGet(pnum, 0), "76581") == 0);
+  assert(phnumGet(pnum, 1) == NULL);
+  assert(strcmp(phnumGet(pnum, 2), "7581") == 0);
+  assert(strcmp(phnumGet(pnum, 3), "76") == 0);
+  assert(phnumGet(pnum, 4) == NULL);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  PhoneForwardStats stats;
+  pf = phfwdNew();
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 0 && stats.maxDepth == 0);
+  assert(phfwdAdd(pf, "12", "345") == true);
+  assert(phfwdAdd(pf, "1267", "345") == true);
+  assert(phfwdAdd(pf, "12", "9") == true);
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 2);
+  assert(stats.forwardBytes == 2 + 4);
+  assert(stats.maxDepth == 4);
+  assert(stats.nodes == 3);
+  assert(stats.fanout[0] == 1 && stats.fanout[1] == 2);
+  phfwdRemove(pf, "126");
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 1 && stats.maxDepth == 2);
+  assert(phfwdAdd(pf, "1267", "9") == true);
+  assert(phfwdSave(pf, "phone_forward_example.img"));
+  phfwdDelete(pf);
+
+  pf = phfwdLoad("phone_forward_example.img");
+  assert(pf != NULL);
+  assert(remove("phone_forward_example.img") == 0);
+  pnum = phfwdGet(pf, "1255");
+  assert(strcmp(phnumGet(pnum, 0), "955") == 0);
+  phnumDelete(pnum);
+  pnum = phfwdReverse(pf, "95");
+  assert(strcmp(phnumGet(pnum, 0), "125") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "12675") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "95") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdAdd(pf, "3", "4") == false);
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 2 && stats.maxDepth == 4);
+  phfwdDelete(pf);
+  assert(phfwdLoad("phone_forward_example.img") == NULL);
+
+  FILE *rules = fopen("phone_forward_example.txt", "w");
+  assert(rules != NULL);
+  fputs("123 9\n1234 8\n\n12 x\n  1235\t7 \n5 5\n", rules);
+  assert(fclose(rules) == 0);
+  PhoneForwardImport summary;
+  pf = phfwdNew();
+  assert(phfwdImportFile(pf, "phone_forward_example.txt", &summary));
+  assert(remove("phone_forward_example.txt") == 0);
+  assert(summary.lines == 6 && summary.added == 3 && summary.errors == 2);
+  assert(summary.firstError == 4 && summary.lastError == 6);
+  pnum = phfwdGet(pf, "12356");
+  assert(strcmp(phnumGet(pnum, 0), "76") == 0);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  char const *sources[] = {"12", "123", "123", "1249", "7"};
+  char const *targets[] = {"4", "9", "5", "9", "12"};
+  pf = phfwdBuild(sources, targets, 5);
+  assert(pf != NULL);
+  pnum = phfwdGet(pf, "1234");
+  assert(strcmp(phnumGet(pnum, 0), "54") == 0);
+  phnumDelete(pnum);
+  pnum = phfwdReverse(pf, "9");
+  assert(strcmp(phnumGet(pnum, 0), "1249") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "9") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  pnum = phfwdGetReverseParallel(pf, "9", 4);
+  assert(strcmp(phnumGet(pnum, 0), "1249") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "9") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdAdd(pf, "8", "1") == true);
+  phfwdDelete(pf);
+  char const *unsorted[] = {"123", "12"};
+  assert(phfwdBuild(unsorted, targets, 2) == NULL);
+
+  pf = phfwdNewConcurrent();
+  assert(pf != NULL);
+  assert(phfwdAdd(pf, "12", "345") == true);
+  assert(phfwdAdd(pf, "1267", "345") == true);
+  assert(phfwdAdd(pf, "126", "9") == true);
+  assert(phfwdGetInto(pf, "12678", buf, sizeof buf) == 4);
+  assert(strcmp(buf, "3458") == 0);
+  phfwdRemove(pf, "1267");
+  assert(phfwdGetInto(pf, "12678", buf, sizeof buf) == 3);
+  assert(strcmp(buf, "978") == 0);
+  pnum = phfwdReverse(pf, "3451");
+  assert(strcmp(phnumGet(pnum, 0), "121") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "3451") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 2 && stats.nodes == 3);
+  PhoneForward *frozen = phfwdFreeze(pf);
   phfwdDelete(pf);
+  assert(frozen != NULL);
+  assert(phfwdGetInto(frozen, "12678", buf, sizeof buf) == 3);
+  assert(strcmp(buf, "978") == 0);
+  pnum = phfwdReverse(frozen, "3451");
+  assert(strcmp(phnumGet(pnum, 0), "121") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "3451") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  cursor = phfwdReverseBegin(frozen, "3451");
+  assert(strcmp(phfwdReverseNext(cursor), "121") == 0);
+  assert(strcmp(phfwdReverseNext(cursor), "3451") == 0);
+  assert(phfwdReverseNext(cursor) == NULL);
+  phfwdReverseEnd(cursor);
+  assert(phfwdAdd(frozen, "5", "6") == false);
+  pf = phfwdFreeze(frozen);
+  phfwdDelete(frozen);
+  pnum = phfwdGet(pf, "1");
+  assert(strcmp(phnumGet(pnum, 0), "1") == 0);
+  phnumDelete(pnum);
+  phfwdDelete(pf);
+
+  pf = phfwdNew();
+  assert(phfwdReclaimerStart(pf) == false);
+  phfwdDelete(pf);
+  pf = phfwdNewConcurrent();
+  assert(phfwdReclaimerStart(pf) == true);
+  assert(phfwdReclaimerStart(pf) == true);
+  assert(phfwdAdd(pf, "4", "5") == true);
+  assert(phfwdAdd(pf, "41", "6") == true);
+  assert(phfwdAdd(pf, "412", "6") == true);
+  assert(phfwdAdd(pf, "7", "6") == true);
+  phfwdRemove(pf, "41");
+  pnum = phfwdReverse(pf, "6");
+  assert(strcmp(phnumGet(pnum, 0), "6") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "7") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  phfwdReclaimerFlush(pf);
+  assert(phfwdStats(pf, &stats));
+  assert(stats.forwards == 2 && stats.nodes == 3);
+  phfwdRemove(pf, "7");
+  phfwdDelete(pf);
+
+  PhoneForwardShards *pfs = phfwdShardsNew();
+  assert(pfs != NULL);
+  assert(phfwdShardsAdd(pfs, "12", "7") == true);
+  assert(phfwdShardsAdd(pfs, "*3", "71") == true);
+  assert(phfwdShardsAdd(pfs, "45", "45") == false);
+  pnum = phfwdShardsGet(pfs, "129");
+  assert(strcmp(phnumGet(pnum, 0), "79") == 0);
+  phnumDelete(pnum);
+  pnum = phfwdShardsReverse(pfs, "715");
+  assert(strcmp(phnumGet(pnum, 0), "1215") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "715") == 0);
+  assert(strcmp(phnumGet(pnum, 2), "*35") == 0);
+  assert(phnumGet(pnum, 3) == NULL);
+  phnumDelete(pnum);
+  assert(phfwdShardsAdd(pfs, "7", "8") == true);
+  pnum = phfwdShardsGetReverse(pfs, "715");
+  assert(strcmp(phnumGet(pnum, 0), "1215") == 0);
+  assert(strcmp(phnumGet(pnum, 1), "*35") == 0);
+  assert(phnumGet(pnum, 2) == NULL);
+  phnumDelete(pnum);
+  phfwdShardsRemove(pfs, "1");
+  pnum = phfwdShardsGet(pfs, "129");
+  assert(strcmp(phnumGet(pnum, 0), "129") == 0);
+  phnumDelete(pnum);
+  phfwdShardsDelete(pfs);
 }
@@ -0,0 +1,198 @@
+/** @file
+ * Implementacja przekierowań numerów podzielonych na części
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phone_forward_shards.h"
+#include "number.h"
+#include "phone_numbers.h"
+
+/**
+ * Rozmiar linii pamięci podręcznej w bajtach.
+ */
+#define SHARD_LINE 64
+
+/** @brief Część przekierowań.
+ * Przechowuje przekierowania prefiksów zaczynających się jedną cyfrą.
+ * Zajmuje własne linie pamięci podręcznej, by blokady różnych części
+ * nie rywalizowały o jedną.
+ */
+typedef struct Shard {
+    /**
+     * Blokada czytelników i pisarzy części.
+     */
+    _Alignas(SHARD_LINE) pthread_rwlock_t lock;
+    /**
+     * Wskaźnik na przekierowania części.
+     */
+    PhoneForward *pf;
+} Shard;
+
+/** @brief Przekierowania numerów podzielone na części.
+ * Część o indeksie @p d przechowuje przekierowania prefiksów, których
+ * pierwsza cyfra ma wartość @p d. Wszystkie prefiksy numeru zaczynają
+ * się tą samą cyfrą, więc przekierowanie numeru wyznacza jedna część.
+ */
+struct PhoneForwardShards {
+    /**
+     * Części indeksowane wartością pierwszej cyfry.
+     */
+    Shard shards[PHFWD_SHARDS];
+};
+
+PhoneForwardShards * phfwdShardsNew(void) {
+    PhoneForwardShards *pfs =
+            aligned_alloc(SHARD_LINE, sizeof(PhoneForwardShards));
+    if (pfs == NULL) {
+        return NULL;
+    }
+    for (short d = 0; d < PHFWD_SHARDS; d++) {
+        Shard *shard = &pfs->shards[d];
+        shard->pf = phfwdNew();
+        if (shard->pf == NULL
+                || pthread_rwlock_init(&shard->lock, NULL) != 0) {
+            phfwdDelete(shard->pf);
+            while (d-- > 0) {
+                pthread_rwlock_destroy(&pfs->shards[d].lock);
+                phfwdDelete(pfs->shards[d].pf);
+            }
+            free(pfs);
+            return NULL;
+        }
+    }
+    return pfs;
+}
+
+void phfwdShardsDelete(PhoneForwardShards *pfs) {
+    if (pfs != NULL) {
+        for (short d = 0; d < PHFWD_SHARDS; d++) {
+            pthread_rwlock_destroy(&pfs->shards[d].lock);
+            phfwdDelete(pfs->shards[d].pf);
+        }
+        free(pfs);
+    }
+}
+
+/** @brief Wyznacza część, do której należy numer.
+ * @param[in] pfs – wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num – wskaźnik na napis reprezentujący poprawny numer.
+ * @return Wskaźnik na część.
+ */
+static inline Shard * shardOf(PhoneForwardShards *pfs, char const *num) {
+    return &pfs->shards[charToInt(num[0])];
+}
+
+bool phfwdShardsAdd(PhoneForwardShards *pfs, char const *num1,
+        char const *num2) {
+    if (pfs == NULL || numberLength(num1) == 0) {
+        return false;
+    }
+    Shard *shard = shardOf(pfs, num1);
+    pthread_rwlock_wrlock(&shard->lock);
+    bool result = phfwdAdd(shard->pf, num1, num2);
+    pthread_rwlock_unlock(&shard->lock);
+    return result;
+}
+
+void phfwdShardsRemove(PhoneForwardShards *pfs, char const *num) {
+    if (pfs == NULL || numberLength(num) == 0) {
+        return;
+    }
+    Shard *shard = shardOf(pfs, num);
+    pthread_rwlock_wrlock(&shard->lock);
+    phfwdRemove(shard->pf, num);
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+PhoneNumbers * phfwdShardsGet(PhoneForwardShards *pfs, char const *num) {
+    if (pfs == NULL) {
+        return NULL;
+    }
+    if (numberLength(num) == 0) {
+        return phnumNew(0, 0);
+    }
+    Shard *shard = shardOf(pfs, num);
+    pthread_rwlock_rdlock(&shard->lock);
+    PhoneNumbers *pnums = phfwdGet(shard->pf, num);
+    pthread_rwlock_unlock(&shard->lock);
+    return pnums;
+}
+
+/** @brief Wyznacza wynik zapytania odwrotnego we wszystkich częściach.
+ * Zadaje zapytanie każdej części, po czym zostawia z jej wyniku tylko
+ * numery zaczynające się cyfrą tej części. Pozostałe numery mogą pochodzić
+ * tylko z tożsamościowego przekierowania numeru @p num, które poprawnie
+ * wyznacza jedynie część tego numeru. Wyniki części są posortowane
+ * i zaczynają się różnymi cyframi, więc wystarczy złączyć je w kolejności
+ * cyfr.
+ * @param[in] pfs – wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num – wskaźnik na napis reprezentujący numer;
+ * @param[in] query – funkcja zapytania odwrotnego.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+static PhoneNumbers * shardsReverse(PhoneForwardShards *pfs,
+        char const *num,
+        PhoneNumbers * (*query)(PhoneForward const *, char const *)) {
+    if (pfs == NULL) {
+        return NULL;
+    }
+    if (numberLength(num) == 0) {
+        return phnumNew(0, 0);
+    }
+
+    PhoneNumbers *parts[PHFWD_SHARDS];
+    for (short d = 0; d < PHFWD_SHARDS; d++) {
+        pthread_rwlock_rdlock(&pfs->shards[d].lock);
+    }
+    bool ok = true;
+    for (short d = 0; d < PHFWD_SHARDS; d++) {
+        parts[d] = ok ? query(pfs->shards[d].pf, num) : NULL;
+        ok = parts[d] != NULL;
+    }
+    for (short d = PHFWD_SHARDS; d-- > 0;) {
+        pthread_rwlock_unlock(&pfs->shards[d].lock);
+    }
+
+    size_t count = 0;
+    size_t chars = 0;
+    for (short d = 0; ok && d < PHFWD_SHARDS; d++) {
+        char const *number;
+        for (size_t i = 0; (number = phnumGet(parts[d], i)) != NULL; i++) {
+            if (charToInt(number[0]) == d) {
+                count++;
+                chars += strlen(number) + 1;
+            }
+        }
+    }
+    PhoneNumbers *pnums = ok ? phnumNew(count, chars) : NULL;
+    for (short d = 0; d < PHFWD_SHARDS; d++) {
+        char const *number;
+        for (size_t i = 0; pnums != NULL
+                && (number = phnumGet(parts[d], i)) != NULL; i++) {
+            if (charToInt(number[0]) == d) {
+                size_t length = strlen(number);
+                memcpy(phnumAppend(pnums, length), number, length + 1);
+            }
+        }
+        phnumDelete(parts[d]);
+    }
+    return pnums;
+}
+
+PhoneNumbers * phfwdShardsReverse(PhoneForwardShards *pfs, char const *num) {
+    return shardsReverse(pfs, num, phfwdReverse);
+}
+
+PhoneNumbers * phfwdShardsGetReverse(PhoneForwardShards *pfs,
+        char const *num) {
+    return shardsReverse(pfs, num, phfwdGetReverse);
+}
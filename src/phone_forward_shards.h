@@ -0,0 +1,107 @@
+/** @file
+ * Interfejs przekierowań numerów podzielonych na części
+ *
+ * Przekierowania dzielone są na @ref PHFWD_SHARDS części według pierwszej
+ * cyfry przekierowywanego prefiksu. Każda część jest osobną strukturą
+ * przekierowań z własną blokadą czytelników i pisarzy, więc zmiany
+ * przekierowań numerów zaczynających się różnymi cyframi nie czekają
+ * na siebie nawzajem.
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __PHONE_FORWARD_SHARDS_H__
+#define __PHONE_FORWARD_SHARDS_H__
+
+#include <stdbool.h>
+#include "phone_forward.h"
+
+/**
+ * Liczba części, równa liczbie różnych cyfr.
+ */
+#define PHFWD_SHARDS PHFWD_MAX_CHILDREN
+
+/**
+ * @typedef PhoneForwardShards
+ * @brief Przekierowania numerów podzielone na części.
+ */
+typedef struct PhoneForwardShards PhoneForwardShards;
+
+/** @brief Tworzy nową strukturę.
+ * Tworzy nową strukturę niezawierającą żadnych przekierowań.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PhoneForwardShards * phfwdShardsNew(void);
+
+/** @brief Usuwa strukturę.
+ * Usuwa strukturę wskazywaną przez @p pfs. Nic nie robi, jeśli wskaźnik
+ * ten ma wartość NULL. Nie wolno jej wywoływać współbieżnie z innymi
+ * funkcjami tej struktury.
+ * @param[in] pfs – wskaźnik na usuwaną strukturę.
+ */
+void phfwdShardsDelete(PhoneForwardShards *pfs);
+
+/** @brief Dodaje przekierowanie.
+ * Działa jak @ref phfwdAdd, blokując tylko część, do której należy
+ * prefiks @p num1.
+ * @param[in,out] pfs – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] num1    – wskaźnik na napis reprezentujący prefiks numerów
+ *                      przekierowywanych;
+ * @param[in] num2    – wskaźnik na napis reprezentujący prefiks numerów,
+ *                      na które jest wykonywane przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
+ *         reprezentuje numeru, oba podane numery są identyczne lub nie
+ *         udało się alokować pamięci.
+ */
+bool phfwdShardsAdd(PhoneForwardShards *pfs, char const *num1,
+                    char const *num2);
+
+/** @brief Usuwa przekierowania.
+ * Działa jak @ref phfwdRemove, blokując tylko część, do której należy
+ * prefiks @p num.
+ * @param[in,out] pfs – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] num     – wskaźnik na napis reprezentujący prefiks numerów.
+ */
+void phfwdShardsRemove(PhoneForwardShards *pfs, char const *num);
+
+/** @brief Wyznacza przekierowanie numeru.
+ * Działa jak @ref phfwdGet, blokując w trybie współdzielonym tylko
+ * część, do której należy numer @p num.
+ * @param[in] pfs – wskaźnik na strukturę przechowującą przekierowania
+ *                  numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdShardsGet(PhoneForwardShards *pfs, char const *num);
+
+/** @brief Wyznacza przekierowania na dany numer.
+ * Działa jak @ref phfwdReverse. Blokuje w trybie współdzielonym
+ * wszystkie części, więc wynik odpowiada jednemu stanowi struktury.
+ * @param[in] pfs – wskaźnik na strukturę przechowującą przekierowania
+ *                  numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdShardsReverse(PhoneForwardShards *pfs, char const *num);
+
+/** @brief Wyznacza numery przekierowywane na dany numer.
+ * Działa jak @ref phfwdGetReverse. Blokuje w trybie współdzielonym
+ * wszystkie części, więc wynik odpowiada jednemu stanowi struktury.
+ * @param[in] pfs – wskaźnik na strukturę przechowującą przekierowania
+ *                  numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         nie udało się alokować pamięci.
+ */
+PhoneNumbers * phfwdShardsGetReverse(PhoneForwardShards *pfs,
+                                     char const *num);
+
+#endif /* __PHONE_FORWARD_SHARDS_H__ */
@@ -0,0 +1,214 @@
+/** @file
+ * Implementacja ciągów numerów telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phone_numbers.h"
+#include "number.h"
+#include "number_sort.h"
+
+/**
+ * Największa liczba strumieni, które funkcja @ref phnumOrderStreams
+ * scala zamiast sortować.
+ */
+#define MERGE_STREAMS 16
+
+PhoneNumbers * phnumNew(size_t capacity, size_t bufferSize) {
+    if (capacity > (SIZE_MAX - sizeof(PhoneNumbers)) / sizeof(size_t)) {
+        return NULL;
+    }
+    PhoneNumbers *pnum = malloc(sizeof(PhoneNumbers)
+            + capacity * sizeof(size_t));
+    if (pnum == NULL) {
+        return NULL;
+    }
+    if (bufferSize == 0) {
+        bufferSize = 1;
+    }
+    pnum->buffer = malloc(bufferSize * sizeof(char));
+    if (pnum->buffer == NULL) {
+        free(pnum);
+        return NULL;
+    }
+    pnum->size = 0;
+    pnum->capacity = capacity;
+    pnum->used = 0;
+    pnum->bufferSize = bufferSize;
+    return pnum;
+}
+
+char * phnumSet(PhoneNumbers *pnum, size_t idx, size_t length) {
+    assert(idx < pnum->size);
+    if (pnum->bufferSize - pnum->used <= length) {
+        size_t bufferSize = pnum->bufferSize;
+        while (bufferSize - pnum->used <= length) {
+            if (bufferSize > SIZE_MAX / 2) return NULL;
+            bufferSize *= 2;
+        }
+        char *buffer = realloc(pnum->buffer, bufferSize * sizeof(char));
+        if (buffer == NULL) {
+            return NULL;
+        }
+        pnum->buffer = buffer;
+        pnum->bufferSize = bufferSize;
+    }
+    pnum->offsets[idx] = pnum->used;
+    pnum->used += length + 1;
+    return pnum->buffer + pnum->offsets[idx];
+}
+
+char * phnumAppend(PhoneNumbers *pnum, size_t length) {
+    phnumAppendNone(pnum);
+    char *out = phnumSet(pnum, pnum->size - 1, length);
+    if (out == NULL) {
+        pnum->size--;
+    }
+    return out;
+}
+
+void phnumAppendNone(PhoneNumbers *pnum) {
+    assert(pnum->size < pnum->capacity);
+    pnum->offsets[pnum->size++] = PHNUM_NONE;
+}
+
+/**
+ * @brief Przesiewa element kopca strumieni w dół.
+ * Kopiec jest uporządkowany według pierwszych numerów strumieni.
+ * @param[in] buffer – wskaźnik na bufor znaków ciągu.
+ * @param[in] offsets – przesunięcia numerów ciągu.
+ * @param[in] head – indeksy pierwszych numerów strumieni.
+ * @param[in,out] heap – tablica numerów strumieni tworząca kopiec.
+ * @param[in] size – liczba elementów kopca.
+ * @param[in] i – indeks przesiewanego elementu.
+ */
+static void siftDown(char const *buffer, size_t const *offsets,
+        size_t const *head, size_t *heap, size_t size, size_t i) {
+    size_t stream = heap[i];
+    char const *num = buffer + offsets[head[stream]];
+    while (2 * i + 1 < size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size
+                && numberCompare(buffer + offsets[head[heap[child + 1]]],
+                    buffer + offsets[head[heap[child]]]) < 0) {
+            child++;
+        }
+        if (numberCompare(num, buffer + offsets[head[heap[child]]]) <= 0) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = stream;
+}
+
+bool phnumMergeStreams(PhoneNumbers *pnum, size_t const *stream,
+        size_t streams) {
+    size_t size = pnum->size;
+    if (size < 2) {
+        return true;
+    }
+    size_t *offsets = malloc((2 * size + 2 * streams) * sizeof(size_t));
+    if (offsets == NULL) {
+        return false;
+    }
+    size_t *next = offsets + size;
+    size_t *head = next + size;
+    size_t *heap = head + streams;
+    memcpy(offsets, pnum->offsets, size * sizeof(size_t));
+
+    for (size_t s = 0; s < streams; s++) {
+        head[s] = SIZE_MAX;
+    }
+    for (size_t i = size; i > 0; i--) {
+        next[i - 1] = head[stream[i - 1]];
+        head[stream[i - 1]] = i - 1;
+    }
+    size_t heapSize = 0;
+    for (size_t s = 0; s < streams; s++) {
+        if (head[s] != SIZE_MAX) {
+            heap[heapSize++] = s;
+        }
+    }
+    for (size_t i = heapSize / 2; i > 0; i--) {
+        siftDown(pnum->buffer, offsets, head, heap, heapSize, i - 1);
+    }
+
+    size_t k = 0;
+    while (heapSize > 0) {
+        size_t s = heap[0];
+        size_t offset = offsets[head[s]];
+        if (k == 0 || strcmp(pnum->buffer + pnum->offsets[k - 1],
+                    pnum->buffer + offset) != 0) {
+            pnum->offsets[k++] = offset;
+        }
+        head[s] = next[head[s]];
+        if (head[s] == SIZE_MAX) {
+            heap[0] = heap[--heapSize];
+        }
+        if (heapSize > 0) {
+            siftDown(pnum->buffer, offsets, head, heap, heapSize, 0);
+        }
+    }
+    pnum->size = k;
+    free(offsets);
+    return true;
+}
+
+bool phnumSort(PhoneNumbers *pnum) {
+    size_t size = pnum->size;
+    if (size < 2) {
+        return true;
+    }
+    char const **keys = malloc(size * sizeof(char const *));
+    if (keys == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        keys[i] = pnum->buffer + pnum->offsets[i];
+    }
+    if (!numberSort(keys, size)) {
+        free(keys);
+        return false;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (k == 0 || strcmp(keys[k - 1], keys[i]) != 0) {
+            keys[k] = keys[i];
+            pnum->offsets[k++] = (size_t) (keys[i] - pnum->buffer);
+        }
+    }
+    pnum->size = k;
+    free(keys);
+    return true;
+}
+
+bool phnumOrderStreams(PhoneNumbers *pnum, size_t const *stream,
+        size_t streams) {
+    if (streams <= MERGE_STREAMS) {
+        return phnumMergeStreams(pnum, stream, streams);
+    }
+    return phnumSort(pnum);
+}
+
+void phnumDelete(PhoneNumbers *pnum) {
+    if (pnum != NULL) {
+        free(pnum->buffer);
+        free(pnum);
+    }
+}
+
+char const * phnumGet(PhoneNumbers const *pnum, size_t idx) {
+    if (pnum == NULL || idx >= pnum->size) {
+        return NULL;
+    }
+    if (pnum->offsets[idx] == PHNUM_NONE) {
+        return NULL;
+    }
+    return pnum->buffer + pnum->offsets[idx];
+}
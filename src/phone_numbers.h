@@ -0,0 +1,128 @@
+/** @file
+ * Interfejs budowania ciągów numerów telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __PHONE_NUMBERS_H__
+#define __PHONE_NUMBERS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "phone_forward.h"
+
+/**
+ * Przesunięcie oznaczające brak numeru na danej pozycji ciągu.
+ */
+#define PHNUM_NONE SIZE_MAX
+
+/** @brief To jest struktura przechowująca ciąg numerów telefonów.
+ * Wszystkie numery leżą jeden za drugim, każdy zakończony znakiem '\0',
+ * we wspólnym buforze znaków, a tablica przesunięć wskazuje początki
+ * kolejnych numerów. Struktura razem z tablicą przesunięć zajmuje jeden
+ * blok pamięci, a bufor znaków drugi.
+ */
+struct PhoneNumbers {
+    /**
+     * Liczba numerów w ciągu.
+     */
+    size_t size;
+    /**
+     * Rozmiar tablicy przesunięć.
+     */
+    size_t capacity;
+    /**
+     * Bufor znaków przechowujący wszystkie numery.
+     */
+    char *buffer;
+    /**
+     * Liczba zajętych znaków bufora.
+     */
+    size_t used;
+    /**
+     * Rozmiar bufora znaków.
+     */
+    size_t bufferSize;
+    /**
+     * Przesunięcia początków numerów w buforze lub @ref PHNUM_NONE.
+     */
+    size_t offsets[];
+};
+
+/** @brief Tworzy pusty ciąg numerów.
+ * @param[in] capacity   – maksymalna liczba numerów w ciągu;
+ * @param[in] bufferSize – początkowy rozmiar bufora znaków.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PhoneNumbers * phnumNew(size_t capacity, size_t bufferSize);
+
+/** @brief Rezerwuje miejsce na kolejny numer.
+ * Dodaje na koniec ciągu numer o długości @p length i zwraca wskaźnik,
+ * pod który należy go zapisać razem z kończącym znakiem '\0'. W razie
+ * potrzeby powiększa bufor znaków, więc zwrócony wskaźnik jest ważny do
+ * następnego wywołania tej funkcji.
+ * @param[in,out] pnum – wskaźnik na ciąg, w którym jest wolna pozycja;
+ * @param[in] length   – długość dodawanego numeru.
+ * @return Wskaźnik na miejsce na numer lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+char * phnumAppend(PhoneNumbers *pnum, size_t length);
+
+/** @brief Rezerwuje miejsce na numer na zadanej pozycji ciągu.
+ * Działa jak @ref phnumAppend, ale zamiast dodawać nową pozycję
+ * zastępuje numer na istniejącej pozycji @p idx.
+ * @param[in,out] pnum – wskaźnik na ciąg;
+ * @param[in] idx      – indeks pozycji mniejszy od liczby numerów;
+ * @param[in] length   – długość zapisywanego numeru.
+ * @return Wskaźnik na miejsce na numer lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+char * phnumSet(PhoneNumbers *pnum, size_t idx, size_t length);
+
+/** @brief Dodaje na koniec ciągu pozycję bez numeru.
+ * @param[in,out] pnum – wskaźnik na ciąg, w którym jest wolna pozycja.
+ */
+void phnumAppendNone(PhoneNumbers *pnum);
+
+/** @brief Scala posortowane strumienie numerów.
+ * Każdy numer ciągu należy do jednego ze strumieni, a numery każdego
+ * strumienia występują w ciągu w kolejności rosnącej. Funkcja ustawia
+ * numery w kolejności rosnącej, przeglądając strumienie za pomocą kopca,
+ * i usuwa powtórzenia. Numery są porządkowane leksykograficznie według
+ * wartości cyfr, a prefiks numeru poprzedza ten numer.
+ * @param[in,out] pnum – wskaźnik na ciąg bez pozycji pustych;
+ * @param[in] stream   – tablica numerów strumieni kolejnych numerów ciągu;
+ * @param[in] streams  – liczba strumieni, większa od numeru każdego z nich.
+ * @return Wartość @p true, jeśli scalenie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+bool phnumMergeStreams(PhoneNumbers *pnum, size_t const *stream,
+        size_t streams);
+
+/** @brief Sortuje ciąg numerów i usuwa z niego powtórzenia.
+ * Używa sortowania @ref numberSort, więc koszt jest proporcjonalny
+ * do łącznej długości numerów.
+ * @param[in,out] pnum – wskaźnik na ciąg bez pozycji pustych.
+ * @return Wartość @p true, jeśli sortowanie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+bool phnumSort(PhoneNumbers *pnum);
+
+/** @brief Porządkuje ciąg złożony z posortowanych strumieni numerów.
+ * Gdy strumieni jest niewiele, scala je funkcją @ref phnumMergeStreams.
+ * W przeciwnym przypadku koszt kopca przewyższa koszt sortowania
+ * pozycyjnego, więc sortuje numery funkcją @ref phnumSort.
+ * @param[in,out] pnum – wskaźnik na ciąg bez pozycji pustych;
+ * @param[in] stream   – tablica numerów strumieni kolejnych numerów ciągu;
+ * @param[in] streams  – liczba strumieni, większa od numeru każdego z nich.
+ * @return Wartość @p true, jeśli porządkowanie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+bool phnumOrderStreams(PhoneNumbers *pnum, size_t const *stream,
+        size_t streams);
+
+#endif /* __PHONE_NUMBERS_H__ */
@@ -0,0 +1,374 @@
+/** @file
+ * Implementacja kursora po wyniku zapytania odwrotnego
+ *
+ * Numery powstałe z prefiksów jednego węzła, z których żaden nie jest
+ * prefiksem drugiego, są uporządkowane tak jak prefiksy. Prefiksy węzła
+ * dzielimy więc, jak w funkcji @ref phfwdReverse, na poziomy według
+ * liczby ich prefiksów zapisanych w tym samym węźle, a numery każdego
+ * poziomu tworzą posortowany strumień. Kursor scala strumienie kopcem,
+ * wyznaczając kolejne numery strumienia dopiero wtedy, gdy są potrzebne.
+ * Strumień głębszego poziomu powstaje, gdy kolejnym prefiksem po pierwszym
+ * numerze strumienia jest jego przedłużenie. Wcześniejsze numery kursora
+ * są od niego mniejsze, bo ten numer jest wtedy pierwszym przedłużeniem
+ * prefiksu z płytszego poziomu, który nie trafił jeszcze do wyniku.
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reverse_cursor.h"
+
+/** @brief Strumień numerów jednego poziomu prefiksów węzła.
+ */
+typedef struct Stream {
+    /**
+     * Wskaźnik na prefiksy węzła lub NULL dla strumienia z samym numerem,
+     * o który pytamy.
+     */
+    SourceList const *list;
+    /**
+     * Indeks węzła na ścieżce drzewa odwrotnych przekierowań.
+     */
+    size_t level;
+    /**
+     * Wskaźnik na resztę numeru doklejaną do prefiksów.
+     */
+    char const *suffix;
+    /**
+     * Długość napisu @p suffix.
+     */
+    size_t lenSuffix;
+    /**
+     * Poziom prefiksów strumienia, czyli liczba prefiksów węzła będących
+     * prefiksami jego prefiksu, razem z nim samym.
+     */
+    size_t depth;
+    /**
+     * Indeks prefiksu, z którego powstał numer @p head.
+     */
+    size_t position;
+    /**
+     * Indeksy prefiksów węzła będących prefiksami prefiksu o indeksie
+     * @p position, od najkrótszego.
+     */
+    size_t *ancestors;
+    /**
+     * Liczba indeksów w tablicy @p ancestors.
+     */
+    size_t height;
+    /**
+     * Bufor z pierwszym numerem strumienia.
+     */
+    char *head;
+} Stream;
+
+/** @brief Kursor po wyniku zapytania odwrotnego.
+ * Strumienie poziomu @p d węzła o indeksie @p i leżą w tablicy
+ * @p streams pod indeksem @p bases[@p i] + @p d - 1, a ostatni strumień
+ * zawiera tylko numer, o który pytamy.
+ */
+struct ReverseCursor {
+    /**
+     * Kopia numeru, o który pytamy.
+     */
+    char *num;
+    /**
+     * Tablica prefiksów węzłów na ścieżce numeru.
+     */
+    SourceList *levels;
+    /**
+     * Tablica indeksów pierwszych strumieni węzłów.
+     */
+    size_t *bases;
+    /**
+     * Tablica liczb utworzonych strumieni węzłów.
+     */
+    size_t *counts;
+    /**
+     * Tablica strumieni.
+     */
+    Stream *streams;
+    /**
+     * Kopiec niepustych strumieni uporządkowany według ich pierwszych
+     * numerów.
+     */
+    Stream **heap;
+    /**
+     * Liczba strumieni w kopcu.
+     */
+    size_t heapSize;
+    /**
+     * Pamięć na tablice @p ancestors strumieni.
+     */
+    size_t *ancestors;
+    /**
+     * Pamięć na bufory numerów.
+     */
+    char *chars;
+    /**
+     * Bufor z ostatnio zwróconym numerem.
+     */
+    char *last;
+    /**
+     * Wolny bufor, wymieniany z buforem zdejmowanego strumienia.
+     */
+    char *spare;
+    /**
+     * Czy kursor zwrócił już jakiś numer.
+     */
+    bool started;
+};
+
+/** @brief Zwraca prefiks z ciągu.
+ * @param[in] list – wskaźnik na ciąg prefiksów;
+ * @param[in] i    – indeks prefiksu.
+ * @return Wskaźnik na spakowany prefiks.
+ */
+static inline PackedNumber const * sourceAt(SourceList const *list,
+        size_t i) {
+    if (list->pointers != NULL) {
+        return list->pointers[i];
+    }
+    return (PackedNumber const *) (list->strings + list->offsets[i]);
+}
+
+/** @brief Wstawia strumień do kopca.
+ * @param[in,out] cursor – wskaźnik na kursor;
+ * @param[in] stream     – wskaźnik na niepusty strumień.
+ */
+static void heapPush(ReverseCursor *cursor, Stream *stream) {
+    Stream **heap = cursor->heap;
+    size_t i = cursor->heapSize++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (numberCompare(heap[parent]->head, stream->head) <= 0) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = stream;
+}
+
+/** @brief Zdejmuje z kopca strumień o najmniejszym pierwszym numerze.
+ * @param[in,out] cursor – wskaźnik na kursor z niepustym kopcem.
+ * @return Wskaźnik na zdjęty strumień.
+ */
+static Stream * heapPop(ReverseCursor *cursor) {
+    Stream **heap = cursor->heap;
+    Stream *top = heap[0];
+    size_t size = --cursor->heapSize;
+    if (size == 0) {
+        return top;
+    }
+    Stream *stream = heap[size];
+    size_t i = 0;
+    while (2 * i + 1 < size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size
+                && numberCompare(heap[child + 1]->head,
+                    heap[child]->head) < 0) {
+            child++;
+        }
+        if (numberCompare(stream->head, heap[child]->head) <= 0) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = stream;
+    return top;
+}
+
+/** @brief Tworzy strumień następnego poziomu, jeśli trzeba.
+ * Strumień poziomu o jeden głębszego powstaje, jeśli jeszcze go nie ma,
+ * a prefiks następujący po pierwszym prefiksie strumienia @p stream jest
+ * jego przedłużeniem. Zaczyna się on od tego przedłużenia.
+ * @param[in,out] cursor – wskaźnik na kursor;
+ * @param[in] stream     – wskaźnik na strumień ustawiony na prefiksie
+ *                         swojego poziomu.
+ * @return Wskaźnik na utworzony strumień lub NULL, jeśli nie powstał.
+ */
+static Stream * streamSpawn(ReverseCursor *cursor, Stream const *stream) {
+    SourceList const *list = stream->list;
+    size_t next = stream->position + 1;
+    if (cursor->counts[stream->level] != stream->depth || next >= list->size
+            || !packedIsPrefix(sourceAt(list, stream->position),
+                sourceAt(list, next))) {
+        return NULL;
+    }
+    Stream *child =
+            &cursor->streams[cursor->bases[stream->level] + stream->depth];
+    cursor->counts[stream->level]++;
+    child->depth = stream->depth + 1;
+    child->position = next;
+    memcpy(child->ancestors, stream->ancestors,
+            stream->height * sizeof(size_t));
+    child->ancestors[stream->height] = next;
+    child->height = stream->height + 1;
+    return child;
+}
+
+/** @brief Zapisuje numer powstały z bieżącego prefiksu strumienia.
+ * @param[in,out] stream – wskaźnik na strumień.
+ */
+static inline void streamHead(Stream *stream) {
+    char *end = packedUnpack(sourceAt(stream->list, stream->position),
+            stream->head);
+    memcpy(end, stream->suffix, stream->lenSuffix + 1);
+}
+
+/** @brief Wyznacza pierwszy numer strumienia.
+ * Zapisuje numer strumienia, po czym tworzy i wstawia do kopca strumienie
+ * głębszych poziomów, które powinny już istnieć.
+ * @param[in,out] cursor – wskaźnik na kursor;
+ * @param[in,out] stream – wskaźnik na strumień ustawiony na prefiksie
+ *                         swojego poziomu.
+ */
+static void streamSettle(ReverseCursor *cursor, Stream *stream) {
+    streamHead(stream);
+    Stream *child;
+    while ((child = streamSpawn(cursor, stream)) != NULL) {
+        streamHead(child);
+        heapPush(cursor, child);
+        stream = child;
+    }
+}
+
+/** @brief Przesuwa strumień na kolejny prefiks jego poziomu.
+ * @param[in,out] cursor – wskaźnik na kursor;
+ * @param[in,out] stream – wskaźnik na strumień.
+ * @return Wartość @p true, jeśli strumień ma kolejny numer.
+ *         Wartość @p false, jeśli strumień się skończył.
+ */
+static bool streamAdvance(ReverseCursor *cursor, Stream *stream) {
+    SourceList const *list = stream->list;
+    size_t *ancestors = stream->ancestors;
+    size_t height = stream->height;
+    for (size_t i = stream->position + 1; i < list->size; i++) {
+        PackedNumber const *source = sourceAt(list, i);
+        while (height > 0 && !packedIsPrefix(
+                    sourceAt(list, ancestors[height - 1]), source)) {
+            height--;
+        }
+        ancestors[height++] = i;
+        if (height == stream->depth) {
+            stream->height = height;
+            stream->position = i;
+            streamSettle(cursor, stream);
+            return true;
+        }
+    }
+    return false;
+}
+
+ReverseCursor * reverseCursorNew(char const *num, size_t length,
+        SourceList *levels, size_t maxDepth) {
+    size_t streams = 1;
+    size_t entries = 0;
+    for (size_t index = 0; index < length; index++) {
+        size_t k = levels[index].size < maxDepth ? levels[index].size
+            : maxDepth;
+        streams += k;
+        entries += k * k;
+    }
+    size_t width = maxDepth + length + 1;
+
+    ReverseCursor *cursor = malloc(sizeof(ReverseCursor));
+    if (cursor == NULL) {
+        free(levels);
+        return NULL;
+    }
+    cursor->levels = levels;
+    cursor->bases = malloc(2 * length * sizeof(size_t));
+    cursor->streams = malloc(streams * sizeof(Stream));
+    cursor->heap = malloc(streams * sizeof(Stream *));
+    cursor->ancestors = malloc((entries + 1) * sizeof(size_t));
+    cursor->chars = malloc((streams + 2) * width + length + 1);
+    if (cursor->bases == NULL || cursor->streams == NULL
+            || cursor->heap == NULL || cursor->ancestors == NULL
+            || cursor->chars == NULL) {
+        reverseCursorDelete(cursor);
+        return NULL;
+    }
+    cursor->counts = cursor->bases + length;
+    cursor->heapSize = 0;
+    cursor->last = cursor->chars;
+    cursor->spare = cursor->chars + width;
+    cursor->started = false;
+    cursor->num = cursor->chars + (streams + 2) * width;
+    memcpy(cursor->num, num, length + 1);
+
+    size_t base = 0;
+    size_t *ancestors = cursor->ancestors;
+    char *head = cursor->chars + 2 * width;
+    for (size_t index = 0; index < length; index++) {
+        size_t k = levels[index].size < maxDepth ? levels[index].size
+            : maxDepth;
+        cursor->bases[index] = base;
+        cursor->counts[index] = 0;
+        for (size_t j = 0; j < k; j++) {
+            Stream *stream = &cursor->streams[base + j];
+            stream->list = &levels[index];
+            stream->level = index;
+            stream->suffix = cursor->num + index + 1;
+            stream->lenSuffix = length - index - 1;
+            stream->ancestors = ancestors;
+            stream->head = head;
+            ancestors += k;
+            head += width;
+        }
+        base += k;
+        if (k > 0) {
+            Stream *stream = &cursor->streams[cursor->bases[index]];
+            cursor->counts[index] = 1;
+            stream->depth = 1;
+            stream->position = 0;
+            stream->ancestors[0] = 0;
+            stream->height = 1;
+            streamSettle(cursor, stream);
+            heapPush(cursor, stream);
+        }
+    }
+    Stream *identity = &cursor->streams[base];
+    identity->list = NULL;
+    identity->head = head;
+    memcpy(identity->head, cursor->num, length + 1);
+    heapPush(cursor, identity);
+    return cursor;
+}
+
+char const * reverseCursorNext(ReverseCursor *cursor) {
+    while (cursor->heapSize > 0) {
+        Stream *stream = heapPop(cursor);
+        char *head = stream->head;
+        stream->head = cursor->spare;
+        cursor->spare = head;
+        if (stream->list != NULL && streamAdvance(cursor, stream)) {
+            heapPush(cursor, stream);
+        }
+        if (!cursor->started || strcmp(head, cursor->last) != 0) {
+            cursor->spare = cursor->last;
+            cursor->last = head;
+            cursor->started = true;
+            return head;
+        }
+    }
+    return NULL;
+}
+
+void reverseCursorDelete(ReverseCursor *cursor) {
+    if (cursor != NULL) {
+        free(cursor->levels);
+        free(cursor->bases);
+        free(cursor->streams);
+        free(cursor->heap);
+        free(cursor->ancestors);
+        free(cursor->chars);
+        free(cursor);
+    }
+}
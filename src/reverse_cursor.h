@@ -0,0 +1,86 @@
+/** @file
+ * Interfejs kursora po wyniku zapytania odwrotnego
+ *
+ * Kursor wyznacza numery zapytania odwrotnego po jednym, w porządku
+ * rosnącym i bez powtórzeń, nie tworząc całego wyniku. Zna tylko prefiksy
+ * zapisane w węzłach ścieżki drzewa odwrotnych przekierowań, więc służy
+ * zarówno drzewu w pamięci, jak i obrazowi.
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __REVERSE_CURSOR_H__
+#define __REVERSE_CURSOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "number.h"
+
+/** @brief Prefiksy jednego węzła drzewa odwrotnych przekierowań.
+ * Prefiksy są posortowane rosnąco i leżą albo w tablicy wskaźników
+ * @p pointers, albo w tablicy napisów obrazu @p strings pod przesunięciami
+ * z tablicy @p offsets.
+ */
+typedef struct SourceList {
+    /**
+     * Tablica wskaźników na prefiksy lub NULL dla prefiksów z obrazu.
+     */
+    PackedNumber * const *pointers;
+    /**
+     * Tablica przesunięć prefiksów w tablicy @p strings.
+     */
+    uint32_t const *offsets;
+    /**
+     * Tablica napisów obrazu.
+     */
+    uint8_t const *strings;
+    /**
+     * Liczba prefiksów.
+     */
+    size_t size;
+} SourceList;
+
+/**
+ * @typedef ReverseCursor
+ * @brief Kursor po wyniku zapytania odwrotnego.
+ */
+typedef struct ReverseCursor ReverseCursor;
+
+/** @brief Tworzy kursor.
+ * Element @p levels[@p i] opisuje prefiksy węzła reprezentującego
+ * pierwsze @p i + 1 cyfr numeru @p num; węzłom, których nie ma
+ * w drzewie, odpowiadają puste ciągi. Kursor wyznacza numery powstałe
+ * z tych prefiksów przez doklejenie reszty numeru @p num oraz sam numer
+ * @p num. Zużywa pamięć zależną od długości numeru i najdłuższego
+ * prefiksu, a nie od liczby wyznaczanych numerów. Prefiksy nie mogą się
+ * zmieniać aż do usunięcia kursora.
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[in] levels   – tablica @p length ciągów prefiksów zaalokowana
+ *                       funkcją malloc, którą kursor przejmuje także
+ *                       w razie błędu;
+ * @param[in] maxDepth – długość najdłuższego prefiksu.
+ * @return Wskaźnik na kursor lub NULL, gdy nie udało się alokować
+ *         pamięci.
+ */
+ReverseCursor * reverseCursorNew(char const *num, size_t length,
+        SourceList *levels, size_t maxDepth);
+
+/** @brief Wyznacza kolejny numer.
+ * Nie alokuje pamięci.
+ * @param[in,out] cursor – wskaźnik na kursor.
+ * @return Wskaźnik na numer, ważny do kolejnego wywołania funkcji
+ *         na tym kursorze, lub NULL, jeśli kursor wyznaczył już
+ *         wszystkie numery.
+ */
+char const * reverseCursorNext(ReverseCursor *cursor);
+
+/** @brief Usuwa kursor.
+ * Nic nie robi, jeśli @p cursor ma wartość NULL.
+ * @param[in] cursor – wskaźnik na usuwany kursor.
+ */
+void reverseCursorDelete(ReverseCursor *cursor);
+
+#endif /* __REVERSE_CURSOR_H__ */
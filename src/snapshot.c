@@ -0,0 +1,406 @@
+/** @file
+ * Implementacja binarnego obrazu przekierowań numerów telefonów
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+#include "number.h"
+#include "phone_numbers.h"
+
+/**
+ * Przyrostek nazwy pliku tymczasowego, do którego zapisywany jest obraz
+ * przed zastąpieniem nim pliku docelowego.
+ */
+#define SNAPSHOT_TEMPORARY ".tmp"
+
+/** @brief Sprawdza, czy sekcja mieści się w obrazie.
+ * @param[in] offset – przesunięcie sekcji;
+ * @param[in] count  – liczba elementów sekcji;
+ * @param[in] size   – rozmiar elementu;
+ * @param[in] total  – rozmiar obrazu.
+ * @return Wartość @p true, jeśli sekcja jest wyrównana i mieści się
+ *         w obrazie.
+ */
+static bool sectionOk(uint64_t offset, uint64_t count, size_t size,
+        uint64_t total) {
+    return offset % SNAPSHOT_ALIGN == 0 && offset <= total
+            && count <= (total - offset) / size;
+}
+
+bool snapshotOpen(Snapshot *snapshot, void const *image, size_t size) {
+    SnapshotHeader const *header = image;
+    if (size < sizeof(SnapshotHeader)
+            || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof header->magic)
+            || header->byteOrder != SNAPSHOT_BYTE_ORDER
+            || header->version != SNAPSHOT_VERSION
+            || header->size != size
+            || header->nodeCount == 0 || header->reverseNodeCount == 0
+            || !sectionOk(header->nodes, header->nodeCount,
+                sizeof(SnapshotNode), size)
+            || !sectionOk(header->reverseNodes, header->reverseNodeCount,
+                sizeof(SnapshotReverseNode), size)
+            || !sectionOk(header->sources, header->sourceCount,
+                sizeof(uint32_t), size)
+            || !sectionOk(header->strings, header->stringsSize, 1, size)) {
+        return false;
+    }
+    uint8_t const *base = image;
+    snapshot->header = header;
+    snapshot->nodes = (SnapshotNode const *) (base + header->nodes);
+    snapshot->reverseNodes =
+            (SnapshotReverseNode const *) (base + header->reverseNodes);
+    snapshot->sources = (uint32_t const *) (base + header->sources);
+    snapshot->strings = base + header->strings;
+    snapshot->mapped = false;
+    return true;
+}
+
+bool snapshotMap(Snapshot *snapshot, char const *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t) st.st_size;
+    void *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return false;
+    }
+    if (!snapshotOpen(snapshot, image, size)) {
+        munmap(image, size);
+        return false;
+    }
+    snapshot->mapped = true;
+    return true;
+}
+
+void snapshotClose(Snapshot *snapshot) {
+    void *image = (void *) snapshot->header;
+    if (snapshot->mapped) {
+        munmap(image, snapshot->header->size);
+    }
+    else {
+        free(image);
+    }
+    snapshot->header = NULL;
+}
+
+bool snapshotWrite(Snapshot const *snapshot, char const *path) {
+    size_t length = strlen(path);
+    char *temporary = malloc(length + sizeof SNAPSHOT_TEMPORARY);
+    if (temporary == NULL) {
+        return false;
+    }
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, SNAPSHOT_TEMPORARY, sizeof SNAPSHOT_TEMPORARY);
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        free(temporary);
+        return false;
+    }
+    size_t size = snapshot->header->size;
+    bool ok = fwrite(snapshot->header, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temporary, path) == 0;
+    if (!ok) {
+        remove(temporary);
+    }
+    free(temporary);
+    return ok;
+}
+
+/** @brief Udostępnia napis obrazu.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] offset   – przesunięcie napisu w tablicy napisów.
+ * @return Wskaźnik na spakowany numer.
+ */
+static inline PackedNumber const * snapshotString(Snapshot const *snapshot,
+        uint32_t offset) {
+    return (PackedNumber const *) (snapshot->strings + offset);
+}
+
+/** @brief Zwraca cyfrę ciągu węzła.
+ * @param[in] node – wskaźnik na węzeł obrazu;
+ * @param[in] k    – indeks cyfry, mniejszy od długości ciągu.
+ * @return Cyfra ciągu.
+ */
+static inline short runDigit(SnapshotNode const *node, uint8_t k) {
+    uint8_t byte = node->run[k / 2];
+    return (short) ((k % 2 == 0) ? byte >> 4 : byte & 0x0F);
+}
+
+/** @brief Zwraca syna węzła dla danej cyfry.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] node     – wskaźnik na węzeł obrazu;
+ * @param[in] digit    – cyfra syna.
+ * @return Wskaźnik na syna lub NULL, jeśli węzeł nie ma takiego syna.
+ */
+static inline SnapshotNode const * nodeChild(Snapshot const *snapshot,
+        SnapshotNode const *node, short digit) {
+    unsigned mask = node->childrenMask;
+    if ((mask & (1u << digit)) == 0) {
+        return NULL;
+    }
+    unsigned index = (unsigned) __builtin_popcount(mask & ((1u << digit) - 1));
+    return &snapshot->nodes[node->firstChild + index];
+}
+
+/** @brief Zwraca syna węzła drzewa odwrotnych przekierowań.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] node     – wskaźnik na węzeł obrazu;
+ * @param[in] digit    – cyfra syna.
+ * @return Wskaźnik na syna lub NULL, jeśli węzeł nie ma takiego syna.
+ */
+static inline SnapshotReverseNode const * reverseChild(
+        Snapshot const *snapshot, SnapshotReverseNode const *node,
+        short digit) {
+    unsigned mask = node->childrenMask;
+    if ((mask & (1u << digit)) == 0) {
+        return NULL;
+    }
+    unsigned index = (unsigned) __builtin_popcount(mask & ((1u << digit) - 1));
+    return &snapshot->reverseNodes[node->firstChild + index];
+}
+
+/** @brief Znajduje najdłuższy prefiks numeru z przekierowaniem.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[out] j       – długość znalezionego prefiksu.
+ * @return Wskaźnik na numer, na który przekierowany jest prefiks,
+ *         lub NULL, jeśli żaden prefiks nie ma przekierowania.
+ */
+static PackedNumber const * lookup(Snapshot const *snapshot,
+        char const *num, size_t length, size_t *j) {
+    SnapshotNode const *node = snapshot->nodes;
+    PackedNumber const *forward = NULL;
+    size_t i = 0;
+    *j = 0;
+    while (true) {
+        for (uint8_t k = 0; k < node->runLength; k++, i++) {
+            if (i == length || charToInt(num[i]) != runDigit(node, k)) {
+                return forward;
+            }
+        }
+        if (node->forward != SNAPSHOT_NONE) {
+            forward = snapshotString(snapshot, node->forward);
+            *j = i;
+        }
+        if (i == length) {
+            return forward;
+        }
+        node = nodeChild(snapshot, node, charToInt(num[i]));
+        if (node == NULL) {
+            return forward;
+        }
+        i++;
+    }
+}
+
+/** @brief Zapisuje wynik wyszukiwania przekierowania.
+ * @param[in] forward – numer, na który przekierowany jest prefiks, lub NULL;
+ * @param[in] suffix  – reszta szukanego numeru;
+ * @param[in] lenSuffix – długość reszty;
+ * @param[out] out    – bufor mieszczący wynik i znak '\0'.
+ */
+static void writeResult(PackedNumber const *forward, char const *suffix,
+        size_t lenSuffix, char *out) {
+    if (forward != NULL) {
+        out = packedUnpack(forward, out);
+    }
+    memcpy(out, suffix, lenSuffix + 1);
+}
+
+PhoneNumbers * snapshotGet(Snapshot const *snapshot, char const *num,
+        size_t length) {
+    PhoneNumbers *pnum = phnumNew(1, 0);
+    if (pnum != NULL) {
+        phnumAppendNone(pnum);
+        if (!snapshotGetAt(snapshot, num, length, pnum, 0)) {
+            phnumDelete(pnum);
+            return NULL;
+        }
+    }
+    return pnum;
+}
+
+bool snapshotGetAt(Snapshot const *snapshot, char const *num,
+        size_t length, PhoneNumbers *pnum, size_t idx) {
+    size_t j;
+    PackedNumber const *forward = lookup(snapshot, num, length, &j);
+    size_t len = length - j + (forward != NULL ? forward->length : 0);
+    char *out = phnumSet(pnum, idx, len);
+    if (out == NULL) {
+        return false;
+    }
+    writeResult(forward, num + j, length - j, out);
+    return true;
+}
+
+size_t snapshotGetInto(Snapshot const *snapshot, char const *num,
+        size_t length, char *buf, size_t cap) {
+    size_t j;
+    PackedNumber const *forward = lookup(snapshot, num, length, &j);
+    size_t len = length - j + (forward != NULL ? forward->length : 0);
+    if (buf != NULL && len < cap) {
+        writeResult(forward, num + j, length - j, buf);
+    }
+    else if (buf != NULL && cap > 0) {
+        buf[0] = '\0';
+    }
+    return len;
+}
+
+/** @brief Sprawdza, czy numer zbudowany z prefiksu jest przekierowywany
+ *  właśnie przez ten prefiks.
+ * Odpowiednik funkcji sprawdzającej w drzewie przekierowań w pamięci.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] source – wskaźnik na spakowany prefiks z przekierowaniem;
+ * @param[in] suffix – wskaźnik na napis doklejany do prefiksu;
+ * @param[in] lenSuffix – długość napisu @p suffix.
+ * @return Wartość @p true, jeśli najdłuższym prefiksem numeru
+ *         z przekierowaniem jest @p source.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+static bool forwardedBy(Snapshot const *snapshot, PackedNumber const *source,
+        char const *suffix, size_t lenSuffix) {
+    size_t lenSource = source->length;
+    size_t length = lenSource + lenSuffix;
+    SnapshotNode const *node = snapshot->nodes;
+    size_t i = 0;
+    while (true) {
+        for (uint8_t k = 0; k < node->runLength; k++, i++) {
+            if (i == length) return true;
+            short digit = i < lenSource ? packedDigit(source, i)
+                : charToInt(suffix[i - lenSource]);
+            if (digit != runDigit(node, k)) return true;
+        }
+        if (i > lenSource && node->forward != SNAPSHOT_NONE) {
+            return false;
+        }
+        if (i == length) return true;
+        short digit = i < lenSource ? packedDigit(source, i)
+            : charToInt(suffix[i - lenSource]);
+        node = nodeChild(snapshot, node, digit);
+        if (node == NULL) return true;
+        i++;
+    }
+}
+
+PhoneNumbers * snapshotReverse(Snapshot const *snapshot, char const *num,
+        size_t length, bool verify) {
+    size_t count = 0;
+    size_t chars = 0;
+    SnapshotReverseNode const *node = snapshot->reverseNodes;
+    for (size_t index = 0; index < length; index++) {
+        node = reverseChild(snapshot, node, charToInt(num[index]));
+        if (node == NULL) {
+            break;
+        }
+        for (uint32_t i = 0; i < node->sourceCount; i++) {
+            uint32_t offset = snapshot->sources[node->firstSource + i];
+            chars += snapshotString(snapshot, offset)->length
+                    + length - index;
+        }
+        count += node->sourceCount;
+    }
+
+    PhoneNumbers *pn = phnumNew(count + 1, chars + length + 1);
+    size_t *stream = malloc(2 * (count + 1) * sizeof(size_t));
+    if (pn == NULL || stream == NULL) {
+        phnumDelete(pn);
+        free(stream);
+        return NULL;
+    }
+    size_t *ancestors = stream + count + 1;
+
+    size_t streams = 0;
+    node = snapshot->reverseNodes;
+    for (size_t index = 0; index < length; index++) {
+        node = reverseChild(snapshot, node, charToInt(num[index]));
+        if (node == NULL) {
+            break;
+        }
+        char const *suffix = num + index + 1;
+        size_t lenSuffix = length - index - 1;
+        uint32_t const *sources = snapshot->sources + node->firstSource;
+        size_t levels = 0;
+        size_t depth = 0;
+        for (uint32_t i = 0; i < node->sourceCount; i++) {
+            PackedNumber const *source = snapshotString(snapshot, sources[i]);
+            while (depth > 0 && !packedIsPrefix(snapshotString(snapshot,
+                            sources[ancestors[depth - 1]]), source)) {
+                depth--;
+            }
+            ancestors[depth++] = i;
+            if (depth > levels) {
+                levels = depth;
+            }
+            if (!verify || forwardedBy(snapshot, source, suffix, lenSuffix)) {
+                stream[pn->size] = streams + depth - 1;
+                char *out = phnumAppend(pn, source->length + lenSuffix);
+                memcpy(packedUnpack(source, out), suffix, lenSuffix + 1);
+            }
+        }
+        streams += levels;
+    }
+
+    size_t j;
+    if (!verify || lookup(snapshot, num, length, &j) == NULL) {
+        stream[pn->size] = streams++;
+        memcpy(phnumAppend(pn, length), num, length + 1);
+    }
+
+    bool ok = phnumOrderStreams(pn, stream, streams);
+    free(stream);
+    if (!ok) {
+        phnumDelete(pn);
+        return NULL;
+    }
+    return pn;
+}
+
+void snapshotReversePath(Snapshot const *snapshot, char const *num,
+        size_t length, SourceList *levels) {
+    SnapshotReverseNode const *node = snapshot->reverseNodes;
+    for (size_t index = 0; index < length; index++) {
+        if (node != NULL) {
+            node = reverseChild(snapshot, node, charToInt(num[index]));
+        }
+        levels[index].pointers = NULL;
+        levels[index].offsets = node == NULL ? NULL
+            : snapshot->sources + node->firstSource;
+        levels[index].strings = snapshot->strings;
+        levels[index].size = node == NULL ? 0 : node->sourceCount;
+    }
+}
+
+void snapshotStats(Snapshot const *snapshot, PhoneForwardStats *stats) {
+    SnapshotHeader const *header = snapshot->header;
+    stats->nodes = header->nodeCount;
+    stats->forwards = header->sourceCount;
+    stats->forwardBytes = header->forwardDigits + header->sourceCount;
+    stats->poolBytes = header->poolBytes;
+    stats->maxDepth = header->maxDepth;
+    for (size_t k = 0; k <= PHFWD_MAX_CHILDREN; k++) {
+        stats->fanout[k] = header->fanout[k];
+    }
+    stats->residentBytes = header->size;
+}
@@ -0,0 +1,327 @@
+/** @file
+ * Interfejs binarnego obrazu przekierowań numerów telefonów
+ *
+ * Obraz to ciągły blok pamięci, który można zapisać do pliku i odwzorować
+ * z powrotem w pamięci bez deserializacji. Wszystkie odwołania wewnątrz
+ * obrazu są indeksami lub przesunięciami, więc obraz nie zależy od adresu,
+ * pod którym się znajduje. Obraz składa się z nagłówka, tablicy węzłów
+ * drzewa przekierowań, tablicy węzłów drzewa odwrotnych przekierowań,
+ * tablicy prefiksów i tablicy napisów ze spakowanymi numerami.
+ * Synowie każdego węzła leżą w tablicy węzłów obok siebie, w kolejności
+ * cyfr, więc węzeł pamięta tylko indeks pierwszego syna i maskę cyfr.
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "phone_forward.h"
+#include "reverse_cursor.h"
+
+/**
+ * Znacznik na początku każdego obrazu.
+ */
+#define SNAPSHOT_MAGIC "PHFWDIMG"
+
+/**
+ * Wersja formatu obrazu.
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * Wartość pola @p byteOrder zapisana na maszynie, która utworzyła obraz.
+ */
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/**
+ * Przesunięcie oznaczające brak napisu.
+ */
+#define SNAPSHOT_NONE UINT32_MAX
+
+/**
+ * Liczba bajtów na cyfry ciągu węzła obrazu, po dwie cyfry na bajt.
+ */
+#define SNAPSHOT_RUN_BYTES 9
+
+/**
+ * Wyrównanie sekcji obrazu w bajtach.
+ */
+#define SNAPSHOT_ALIGN 8
+
+/** @brief Nagłówek obrazu.
+ * Przesunięcia sekcji liczone są od początku obrazu.
+ */
+typedef struct SnapshotHeader {
+    /**
+     * Znacznik @ref SNAPSHOT_MAGIC.
+     */
+    char magic[8];
+    /**
+     * Wartość @ref SNAPSHOT_BYTE_ORDER w porządku bajtów twórcy obrazu.
+     */
+    uint32_t byteOrder;
+    /**
+     * Wersja formatu, @ref SNAPSHOT_VERSION.
+     */
+    uint32_t version;
+    /**
+     * Rozmiar całego obrazu w bajtach.
+     */
+    uint64_t size;
+    /**
+     * Przesunięcie tablicy węzłów drzewa przekierowań; korzeń ma indeks 0.
+     */
+    uint64_t nodes;
+    /**
+     * Liczba węzłów drzewa przekierowań.
+     */
+    uint64_t nodeCount;
+    /**
+     * Przesunięcie tablicy węzłów drzewa odwrotnych przekierowań;
+     * korzeń ma indeks 0.
+     */
+    uint64_t reverseNodes;
+    /**
+     * Liczba węzłów drzewa odwrotnych przekierowań.
+     */
+    uint64_t reverseNodeCount;
+    /**
+     * Przesunięcie tablicy przesunięć prefiksów w tablicy napisów.
+     */
+    uint64_t sources;
+    /**
+     * Liczba prefiksów, równa liczbie przekierowań.
+     */
+    uint64_t sourceCount;
+    /**
+     * Przesunięcie tablicy napisów.
+     */
+    uint64_t strings;
+    /**
+     * Rozmiar tablicy napisów w bajtach.
+     */
+    uint64_t stringsSize;
+    /**
+     * Łączna długość numerów, na które wykonywane są przekierowania.
+     */
+    uint64_t forwardDigits;
+    /**
+     * Łączny rozmiar spakowanych numerów, na które wykonywane są
+     * przekierowania.
+     */
+    uint64_t poolBytes;
+    /**
+     * Długość najdłuższego przekierowywanego prefiksu.
+     */
+    uint64_t maxDepth;
+    /**
+     * Liczby węzłów o kolejnych liczbach synów.
+     */
+    uint64_t fanout[PHFWD_MAX_CHILDREN + 1];
+} SnapshotHeader;
+
+/** @brief Węzeł drzewa przekierowań w obrazie.
+ * Odpowiada węzłowi drzewa w pamięci: krawędź prowadząca do węzła to
+ * cyfra syna w ojcu, po której następuje ciąg cyfr @p run.
+ */
+typedef struct SnapshotNode {
+    /**
+     * Przesunięcie w tablicy napisów numeru, na który mamy
+     * przekierowanie, lub @ref SNAPSHOT_NONE.
+     */
+    uint32_t forward;
+    /**
+     * Indeks pierwszego syna w tablicy węzłów.
+     */
+    uint32_t firstChild;
+    /**
+     * Maska bitowa cyfr, dla których węzeł ma syna.
+     */
+    uint16_t childrenMask;
+    /**
+     * Liczba cyfr ciągu @p run.
+     */
+    uint8_t runLength;
+    /**
+     * Spakowane cyfry ciągu, od starszej połówki bajtu.
+     */
+    uint8_t run[SNAPSHOT_RUN_BYTES];
+} SnapshotNode;
+
+/** @brief Węzeł drzewa odwrotnych przekierowań w obrazie.
+ */
+typedef struct SnapshotReverseNode {
+    /**
+     * Indeks pierwszego syna w tablicy węzłów.
+     */
+    uint32_t firstChild;
+    /**
+     * Indeks pierwszego prefiksu węzła w tablicy prefiksów.
+     */
+    uint32_t firstSource;
+    /**
+     * Liczba prefiksów węzła; są one posortowane rosnąco.
+     */
+    uint32_t sourceCount;
+    /**
+     * Maska bitowa cyfr, dla których węzeł ma syna.
+     */
+    uint16_t childrenMask;
+    /**
+     * Nieużywane, wyrównuje węzeł do 16 bajtów.
+     */
+    uint16_t unused;
+} SnapshotReverseNode;
+
+/** @brief Obraz przekierowań otwarty do odczytu.
+ */
+typedef struct Snapshot {
+    /**
+     * Wskaźnik na początek obrazu.
+     */
+    SnapshotHeader const *header;
+    /**
+     * Tablica węzłów drzewa przekierowań.
+     */
+    SnapshotNode const *nodes;
+    /**
+     * Tablica węzłów drzewa odwrotnych przekierowań.
+     */
+    SnapshotReverseNode const *reverseNodes;
+    /**
+     * Tablica przesunięć prefiksów w tablicy napisów.
+     */
+    uint32_t const *sources;
+    /**
+     * Tablica napisów.
+     */
+    uint8_t const *strings;
+    /**
+     * Czy obraz jest odwzorowanym plikiem, a nie blokiem z malloc.
+     */
+    bool mapped;
+} Snapshot;
+
+/** @brief Zaokrągla rozmiar w górę do wyrównania sekcji.
+ * @param[in] size – rozmiar w bajtach.
+ * @return Najmniejsza wielokrotność @ref SNAPSHOT_ALIGN nie mniejsza
+ *         od @p size.
+ */
+static inline size_t snapshotAlign(size_t size) {
+    return (size + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+/** @brief Otwiera obraz znajdujący się w pamięci.
+ * Sprawdza nagłówek obrazu i położenie jego sekcji. Zawartość sekcji
+ * nie jest sprawdzana, więc obraz musi być utworzony przez tę bibliotekę,
+ * np. zapisany funkcją @ref phfwdSave.
+ * @param[out] snapshot – wskaźnik na otwierany obraz;
+ * @param[in] image     – wskaźnik na początek obrazu, wyrównany jak wynik
+ *                        funkcji malloc;
+ * @param[in] size      – rozmiar bloku pamięci z obrazem.
+ * @return Wartość @p true, jeśli obraz jest poprawny.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+bool snapshotOpen(Snapshot *snapshot, void const *image, size_t size);
+
+/** @brief Odwzorowuje plik z obrazem w pamięci i otwiera go.
+ * @param[out] snapshot – wskaźnik na otwierany obraz;
+ * @param[in] path      – ścieżka do pliku.
+ * @return Wartość @p true, jeśli obraz został otwarty.
+ *         Wartość @p false, jeśli nie udało się odczytać pliku lub
+ *         nie zawiera on poprawnego obrazu.
+ */
+bool snapshotMap(Snapshot *snapshot, char const *path);
+
+/** @brief Zamyka obraz.
+ * Zwalnia pamięć obrazu lub kończy odwzorowanie pliku.
+ * @param[in,out] snapshot – wskaźnik na otwarty obraz.
+ */
+void snapshotClose(Snapshot *snapshot);
+
+/** @brief Zapisuje obraz do pliku.
+ * Zapisuje obraz do pliku tymczasowego obok pliku docelowego i zastępuje
+ * nim plik docelowy, więc obrazy odwzorowane wcześniej z tego pliku,
+ * w tym sam zapisywany obraz, pozostają ważne.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] path     – ścieżka do pliku.
+ * @return Wartość @p true, jeśli obraz został zapisany.
+ *         Wartość @p false w przeciwnym przypadku.
+ */
+bool snapshotWrite(Snapshot const *snapshot, char const *path);
+
+/** @brief Wyznacza przekierowanie numeru.
+ * Działa jak @ref phfwdGet.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num.
+ * @return Wskaźnik na ciąg z jednym numerem lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PhoneNumbers * snapshotGet(Snapshot const *snapshot, char const *num,
+        size_t length);
+
+/** @brief Wyznacza przekierowanie numeru do bufora.
+ * Działa jak @ref phfwdGetInto.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[out] buf     – wskaźnik na bufor na wynik lub NULL;
+ * @param[in] cap      – rozmiar bufora @p buf w bajtach.
+ * @return Długość wyniku.
+ */
+size_t snapshotGetInto(Snapshot const *snapshot, char const *num,
+        size_t length, char *buf, size_t cap);
+
+/** @brief Zapisuje przekierowanie numeru na zadanej pozycji ciągu.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[in,out] pnum – wskaźnik na ciąg numerów;
+ * @param[in] idx      – indeks pozycji w @p pnum.
+ * @return Wartość @p true, jeśli wynik został zapisany.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+bool snapshotGetAt(Snapshot const *snapshot, char const *num,
+        size_t length, PhoneNumbers *pnum, size_t idx);
+
+/** @brief Wyznacza przekierowania na dany numer.
+ * Działa jak @ref phfwdReverse lub, jeśli @p verify jest prawdą,
+ * jak @ref phfwdGetReverse.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[in] verify   – czy zostawić tylko numery przekierowywane
+ *                       na numer @p num.
+ * @return Wskaźnik na ciąg numerów lub NULL, gdy nie udało się
+ *         alokować pamięci.
+ */
+PhoneNumbers * snapshotReverse(Snapshot const *snapshot, char const *num,
+        size_t length, bool verify);
+
+/** @brief Wyznacza prefiksy węzłów ścieżki numeru w drzewie odwrotnych
+ *  przekierowań.
+ * Wypełnia tablicę przekazywaną funkcji @ref reverseCursorNew.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[in] num      – wskaźnik na poprawny numer;
+ * @param[in] length   – długość numeru @p num;
+ * @param[out] levels  – tablica @p length ciągów prefiksów.
+ */
+void snapshotReversePath(Snapshot const *snapshot, char const *num,
+        size_t length, SourceList *levels);
+
+/** @brief Wyznacza statystyki obrazu.
+ * Działa jak @ref phfwdStats; szacowany rozmiar pamięci to rozmiar
+ * obrazu.
+ * @param[in] snapshot – wskaźnik na otwarty obraz;
+ * @param[out] stats   – wskaźnik na wypełniane statystyki.
+ */
+void snapshotStats(Snapshot const *snapshot, PhoneForwardStats *stats);
+
+#endif /* __SNAPSHOT_H__ */
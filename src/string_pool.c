@@ -0,0 +1,252 @@
+/** @file
+ * Implementacja puli współdzielonych napisów bajtowych
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_pool.h"
+
+/** @brief Wpis puli przechowujący jeden napis bajtowy.
+ */
+struct PoolEntry {
+    /**
+     * Wskaźnik na napis lub NULL dla wolnego wpisu.
+     */
+    void *data;
+    /**
+     * Długość napisu w bajtach.
+     */
+    size_t size;
+    /**
+     * Liczba odwołań do napisu.
+     */
+    uint32_t refs;
+    /**
+     * Wartość funkcji haszującej napisu.
+     */
+    uint32_t hash;
+    /**
+     * Uchwyt następnego wpisu w łańcuchu kubełka lub na liście wolnych.
+     */
+    uint32_t next;
+};
+
+/** @brief Hashuje napis.
+ * Używa funkcji FNV-1a.
+ * @param[in] data – wskaźnik na napis;
+ * @param[in] size – długość napisu w bajtach.
+ * @return Wartość funkcji haszującej.
+ */
+static uint32_t hashBytes(void const *data, size_t size) {
+    unsigned char const *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/** @brief Powiększa tablicę kubełków.
+ * Podwaja liczbę kubełków i rozkłada na nie ponownie wszystkie wpisy.
+ * @param[in,out] pool – wskaźnik na pulę.
+ * @return Wartość @p true, jeśli powiększenie się powiodło.
+ *         Wartość @p false, jeśli nie udało się alokować pamięci.
+ */
+static bool growBuckets(StringPool *pool) {
+    uint32_t bucketCount = pool->bucketCount == 0 ? 16 : pool->bucketCount * 2;
+    uint32_t *buckets = calloc(bucketCount, sizeof(uint32_t));
+    if (buckets == NULL) {
+        return false;
+    }
+    for (uint32_t h = 1; h < pool->size; h++) {
+        PoolEntry *entry = &pool->entries[h];
+        if (entry->data != NULL && entry->refs > 0) {
+            uint32_t bucket = entry->hash & (bucketCount - 1);
+            entry->next = buckets[bucket];
+            buckets[bucket] = h;
+        }
+    }
+    free(pool->buckets);
+    pool->buckets = buckets;
+    pool->bucketCount = bucketCount;
+    return true;
+}
+
+/** @brief Przydziela wolny wpis.
+ * @param[in,out] pool – wskaźnik na pulę.
+ * @return Uchwyt wolnego wpisu lub @ref POOL_NONE, gdy nie udało się
+ *         alokować pamięci.
+ */
+static uint32_t allocEntry(StringPool *pool) {
+    if (pool->freeList != POOL_NONE) {
+        uint32_t handle = pool->freeList;
+        pool->freeList = pool->entries[handle].next;
+        return handle;
+    }
+    if (pool->size == pool->capacity) {
+        if (pool->capacity > UINT32_MAX / 2) {
+            return POOL_NONE;
+        }
+        uint32_t capacity = pool->capacity == 0 ? 16 : pool->capacity * 2;
+        PoolEntry *entries;
+        if (pool->deferred) {
+            entries = malloc(capacity * sizeof(PoolEntry));
+            if (entries == NULL) {
+                return POOL_NONE;
+            }
+            if (pool->entries != NULL) {
+                memcpy(entries, pool->entries,
+                        pool->size * sizeof(PoolEntry));
+                pool->entries[0].data = pool->retired;
+                pool->retired = pool->entries;
+            }
+        }
+        else {
+            entries = realloc(pool->entries, capacity * sizeof(PoolEntry));
+            if (entries == NULL) {
+                return POOL_NONE;
+            }
+        }
+        entries[0].data = NULL;
+        if (pool->size == 0) {
+            pool->size = 1;
+        }
+        __atomic_store_n(&pool->entries, entries, __ATOMIC_RELEASE);
+        pool->capacity = capacity;
+    }
+    return pool->size++;
+}
+
+void poolInit(StringPool *pool) {
+    pool->entries = NULL;
+    pool->size = 0;
+    pool->capacity = 0;
+    pool->freeList = POOL_NONE;
+    pool->buckets = NULL;
+    pool->bucketCount = 0;
+    pool->count = 0;
+    pool->bytes = 0;
+    pool->deferred = false;
+    pool->pending = POOL_NONE;
+    pool->retired = NULL;
+}
+
+void poolDestroy(StringPool *pool) {
+    poolCollect(pool);
+    for (uint32_t h = 1; h < pool->size; h++) {
+        free(pool->entries[h].data);
+    }
+    free(pool->entries);
+    free(pool->buckets);
+    bool deferred = pool->deferred;
+    poolInit(pool);
+    pool->deferred = deferred;
+}
+
+void poolSetDeferred(StringPool *pool) {
+    pool->deferred = true;
+}
+
+void poolCollect(StringPool *pool) {
+    while (pool->pending != POOL_NONE) {
+        PoolEntry *entry = &pool->entries[pool->pending];
+        uint32_t next = entry->next;
+        free(entry->data);
+        entry->data = NULL;
+        entry->next = pool->freeList;
+        pool->freeList = pool->pending;
+        pool->pending = next;
+    }
+    while (pool->retired != NULL) {
+        PoolEntry *next = pool->retired[0].data;
+        free(pool->retired);
+        pool->retired = next;
+    }
+}
+
+uint32_t poolIntern(StringPool *pool, void const *data, size_t size) {
+    uint32_t hash = hashBytes(data, size);
+    if (pool->bucketCount != 0) {
+        uint32_t h = pool->buckets[hash & (pool->bucketCount - 1)];
+        while (h != POOL_NONE) {
+            PoolEntry *entry = &pool->entries[h];
+            if (entry->hash == hash && entry->size == size
+                    && memcmp(entry->data, data, size) == 0) {
+                entry->refs++;
+                return h;
+            }
+            h = entry->next;
+        }
+    }
+
+    if (pool->count >= pool->bucketCount / 4 * 3 && !growBuckets(pool)) {
+        return POOL_NONE;
+    }
+    void *copy = malloc(size);
+    if (copy == NULL) {
+        return POOL_NONE;
+    }
+    memcpy(copy, data, size);
+    uint32_t handle = allocEntry(pool);
+    if (handle == POOL_NONE) {
+        free(copy);
+        return POOL_NONE;
+    }
+    PoolEntry *entry = &pool->entries[handle];
+    uint32_t bucket = hash & (pool->bucketCount - 1);
+    entry->data = copy;
+    entry->size = size;
+    entry->refs = 1;
+    entry->hash = hash;
+    entry->next = pool->buckets[bucket];
+    pool->buckets[bucket] = handle;
+    pool->count++;
+    pool->bytes += size;
+    return handle;
+}
+
+void poolRelease(StringPool *pool, uint32_t handle) {
+    if (handle == POOL_NONE) {
+        return;
+    }
+    PoolEntry *entry = &pool->entries[handle];
+    assert(entry->data != NULL && entry->refs > 0);
+    if (--entry->refs > 0) {
+        return;
+    }
+
+    uint32_t *link = &pool->buckets[entry->hash & (pool->bucketCount - 1)];
+    while (*link != handle) {
+        link = &pool->entries[*link].next;
+    }
+    *link = entry->next;
+    pool->bytes -= entry->size;
+    pool->count--;
+    if (pool->deferred) {
+        entry->next = pool->pending;
+        pool->pending = handle;
+        return;
+    }
+    free(entry->data);
+    entry->data = NULL;
+    entry->next = pool->freeList;
+    pool->freeList = handle;
+}
+
+size_t poolBytes(StringPool const *pool) {
+    return pool->bytes + pool->capacity * sizeof(PoolEntry)
+            + pool->bucketCount * sizeof(uint32_t);
+}
+
+void const * poolGet(StringPool const *pool, uint32_t handle) {
+    assert(handle != POOL_NONE);
+    PoolEntry const *entries =
+            __atomic_load_n(&pool->entries, __ATOMIC_ACQUIRE);
+    return entries[handle].data;
+}
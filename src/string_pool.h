@@ -0,0 +1,146 @@
+/** @file
+ * Interfejs puli współdzielonych napisów bajtowych
+ *
+ * @author Mateusz Mroczka <mm439938@students.mimuw.edu.pl>
+ * @copyright Uniwersytet Warszawski
+ * @date 2022
+ */
+
+#ifndef __STRING_POOL_H__
+#define __STRING_POOL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Uchwyt niewskazujący na żaden napis.
+ */
+#define POOL_NONE 0
+
+/**
+ * @typedef PoolEntry
+ * @brief Wpis puli przechowujący jeden napis bajtowy.
+ */
+typedef struct PoolEntry PoolEntry;
+
+/** @brief Pula współdzielonych napisów bajtowych.
+ * Przechowuje każdy napis raz, razem z licznikiem odwołań. Napisy to
+ * dowolne ciągi bajtów o zadanej długości, identyfikowane liczbowymi
+ * uchwytami, a wyszukiwanie po treści odbywa się przez tablicę haszującą.
+ */
+typedef struct StringPool {
+    /**
+     * Tablica wpisów indeksowana uchwytami; wpis 0 jest nieużywany.
+     */
+    PoolEntry *entries;
+    /**
+     * Liczba wykorzystanych wpisów, łącznie z wpisem 0.
+     */
+    uint32_t size;
+    /**
+     * Rozmiar zaalokowanej tablicy wpisów.
+     */
+    uint32_t capacity;
+    /**
+     * Lista wolnych wpisów, połączona polami @p next.
+     */
+    uint32_t freeList;
+    /**
+     * Tablica kubełków z uchwytami pierwszych wpisów łańcuchów.
+     */
+    uint32_t *buckets;
+    /**
+     * Liczba kubełków, zawsze potęga dwójki.
+     */
+    uint32_t bucketCount;
+    /**
+     * Liczba przechowywanych napisów.
+     */
+    uint32_t count;
+    /**
+     * Łączna długość przechowywanych napisów w bajtach.
+     */
+    size_t bytes;
+    /**
+     * Czy usunięte napisy i zastąpione tablice wpisów są zwalniane
+     * dopiero przez @ref poolCollect.
+     */
+    bool deferred;
+    /**
+     * Lista usuniętych wpisów, których napisy czekają na zwolnienie,
+     * połączona polami @p next.
+     */
+    uint32_t pending;
+    /**
+     * Lista zastąpionych tablic wpisów czekających na zwolnienie,
+     * połączona polami @p data ich wpisów 0.
+     */
+    PoolEntry *retired;
+} StringPool;
+
+/** @brief Inicjuje pustą pulę.
+ * Nie alokuje pamięci.
+ * @param[out] pool – wskaźnik na inicjowaną pulę.
+ */
+void poolInit(StringPool *pool);
+
+/** @brief Zwalnia pamięć puli.
+ * Zwalnia wszystkie napisy naraz, niezależnie od ich liczników odwołań.
+ * Pula pozostaje pusta i można jej dalej używać.
+ * @param[in,out] pool – wskaźnik na pulę.
+ */
+void poolDestroy(StringPool *pool);
+
+/** @brief Włącza odroczone zwalnianie pamięci.
+ * Napis, do którego usunięto ostatnie odwołanie, przestaje być w puli,
+ * ale jego pamięć i uchwyt pozostają ważne, a po powiększeniu tablicy
+ * wpisów ważna pozostaje też poprzednia tablica, aż do wywołania
+ * @ref poolCollect. Dzięki temu funkcję @ref poolGet można wywoływać
+ * współbieżnie ze zmianami puli.
+ * @param[in,out] pool – wskaźnik na pulę.
+ */
+void poolSetDeferred(StringPool *pool);
+
+/** @brief Zwalnia pamięć, której zwolnienie odroczono.
+ * Wywołujący musi zapewnić, że żaden wątek nie czyta już napisów ani
+ * tablic wpisów usuniętych przed wywołaniem.
+ * @param[in,out] pool – wskaźnik na pulę.
+ */
+void poolCollect(StringPool *pool);
+
+/** @brief Dodaje odwołanie do napisu.
+ * Jeśli napis równy @p data jest już w puli, zwiększa jego licznik
+ * odwołań, a w przeciwnym przypadku dodaje kopię napisu.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] data     – wskaźnik na napis;
+ * @param[in] size     – długość napisu w bajtach.
+ * @return Uchwyt napisu lub @ref POOL_NONE, gdy nie udało się
+ *         alokować pamięci.
+ */
+uint32_t poolIntern(StringPool *pool, void const *data, size_t size);
+
+/** @brief Usuwa odwołanie do napisu.
+ * Zmniejsza licznik odwołań napisu i usuwa go, gdy licznik spadnie
+ * do zera. Nic nie robi dla uchwytu @ref POOL_NONE.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] handle   – uchwyt napisu.
+ */
+void poolRelease(StringPool *pool, uint32_t handle);
+
+/** @brief Udostępnia napis.
+ * @param[in] pool   – wskaźnik na pulę;
+ * @param[in] handle – uchwyt napisu różny od @ref POOL_NONE.
+ * @return Wskaźnik na napis, ważny do usunięcia ostatniego odwołania.
+ *         Napis jest wyrównany jak wynik funkcji malloc.
+ */
+void const * poolGet(StringPool const *pool, uint32_t handle);
+
+/** @brief Zwraca rozmiar pamięci puli.
+ * @param[in] pool – wskaźnik na pulę.
+ * @return Łączny rozmiar napisów, tablicy wpisów i tablicy kubełków
+ *         w bajtach.
+ */
+size_t poolBytes(StringPool const *pool);
+
+#endif /* __STRING_POOL_H__ */